@@ -26,9 +26,14 @@ namespace ofc {
         // Функция теперь заполняет переданный по ссылке вектор.
         inline void get_row_cards(const std::string& row_name, CardSet& out_cards) const {
             out_cards.clear();
-            if (row_name == "top") for(Card c : top) if (c != INVALID_CARD) out_cards.push_back(c);
-            else if (row_name == "middle") for(Card c : middle) if (c != INVALID_CARD) out_cards.push_back(c);
-            else if (row_name == "bottom") for(Card c : bottom) if (c != INVALID_CARD) out_cards.push_back(c);
+            // ИСПРАВЛЕНО: без скобок else привязывался к внутреннему if, и middle/bottom всегда были пусты.
+            if (row_name == "top") {
+                for(Card c : top) if (c != INVALID_CARD) out_cards.push_back(c);
+            } else if (row_name == "middle") {
+                for(Card c : middle) if (c != INVALID_CARD) out_cards.push_back(c);
+            } else if (row_name == "bottom") {
+                for(Card c : bottom) if (c != INVALID_CARD) out_cards.push_back(c);
+            }
         }
 
         // УЛУЧШЕНО: API изменен для предотвращения лишних аллокаций памяти.
@@ -40,48 +45,44 @@ namespace ofc {
         }
 
         inline int get_card_count() const {
-            CardSet all;
-            get_all_cards(all);
-            return all.size();
+            int count = 0;
+            for (Card c : top) count += (c != INVALID_CARD);
+            for (Card c : middle) count += (c != INVALID_CARD);
+            for (Card c : bottom) count += (c != INVALID_CARD);
+            return count;
         }
 
+        // УЛУЧШЕНО: ряды собираются в буферы на стеке — проверки фола и роялти
+        // на терминальных узлах обхода больше не обращаются к куче.
         inline bool is_foul(const HandEvaluator& evaluator) const {
             if (get_card_count() != 13) return false;
-            
-            // УЛУЧШЕНО: Используем новый API, создавая векторы на стеке один раз.
-            CardSet top_cards, mid_cards, bot_cards;
-            get_row_cards("top", top_cards);
-            get_row_cards("middle", mid_cards);
-            get_row_cards("bottom", bot_cards);
-
-            HandRank top_rank = evaluator.evaluate(top_cards);
-            HandRank mid_rank = evaluator.evaluate(mid_cards);
-            HandRank bot_rank = evaluator.evaluate(bot_cards);
+
+            HandRank top_rank = evaluator.evaluate(top.data(), top.size());
+            HandRank mid_rank = evaluator.evaluate(middle.data(), middle.size());
+            HandRank bot_rank = evaluator.evaluate(bottom.data(), bottom.size());
             return (mid_rank < bot_rank) || (top_rank < mid_rank);
         }
 
         inline int get_total_royalty(const HandEvaluator& evaluator) const {
             if (is_foul(evaluator)) return 0;
 
-            // УЛУЧШЕНО: Используем новый API.
-            CardSet top_cards, mid_cards, bot_cards;
-            get_row_cards("top", top_cards);
-            get_row_cards("middle", mid_cards);
-            get_row_cards("bottom", bot_cards);
-
-            return evaluator.get_royalty(top_cards, "top") +
-                   evaluator.get_royalty(mid_cards, "middle") +
-                   evaluator.get_royalty(bot_cards, "bottom");
+            std::array<Card, 5> buf;
+            int royalty = 0;
+            size_t n = collect_row(top, buf);
+            royalty += evaluator.get_royalty(buf.data(), n, "top");
+            n = collect_row(middle, buf);
+            royalty += evaluator.get_royalty(buf.data(), n, "middle");
+            n = collect_row(bottom, buf);
+            royalty += evaluator.get_royalty(buf.data(), n, "bottom");
+            return royalty;
         }
 
         inline bool qualifies_for_fantasyland(const HandEvaluator& evaluator) const {
             if (is_foul(evaluator)) return false;
-            
-            CardSet top_cards;
-            get_row_cards("top", top_cards);
 
-            if (top_cards.size() != 3) return false;
-            HandRank hr = evaluator.evaluate(top_cards);
+            std::array<Card, 5> top_cards;
+            if (collect_row(top, top_cards) != 3) return false;
+            HandRank hr = evaluator.evaluate(top_cards.data(), 3);
             if (hr.type_str == "Pair") {
                 int r0 = get_rank(top_cards[0]), r1 = get_rank(top_cards[1]), r2 = get_rank(top_cards[2]);
                 int pair_rank = (r0 == r1 || r0 == r2) ? r0 : r1;
@@ -92,14 +93,11 @@ namespace ofc {
 
         inline int get_fantasyland_card_count(const HandEvaluator& evaluator) const {
             if (!qualifies_for_fantasyland(evaluator)) return 0;
-            
-            CardSet top_cards;
-            get_row_cards("top", top_cards);
 
-            HandRank hr = evaluator.evaluate(top_cards);
+            HandRank hr = evaluator.evaluate(top.data(), top.size());
             if (hr.type_str == "Trips") return 17;
             if (hr.type_str == "Pair") {
-                int r0 = get_rank(top_cards[0]), r1 = get_rank(top_cards[1]), r2 = get_rank(top_cards[2]);
+                int r0 = get_rank(top[0]), r1 = get_rank(top[1]), r2 = get_rank(top[2]);
                 int pair_rank = (r0 == r1 || r0 == r2) ? r0 : r1;
                 if (pair_rank == 10) return 14; // QQ
                 if (pair_rank == 11) return 15; // KK
@@ -107,5 +105,13 @@ namespace ofc {
             }
             return 0;
         }
+
+        // Карты ряда без пустых слотов в буфер; возвращает их число.
+        template <size_t N>
+        static inline size_t collect_row(const std::array<Card, N>& row, std::array<Card, 5>& out) {
+            size_t n = 0;
+            for (Card c : row) if (c != INVALID_CARD) out[n++] = c;
+            return n;
+        }
     };
 }
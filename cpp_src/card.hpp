@@ -2,6 +2,7 @@
 #include <cstdint>
 #include <string>
 #include <vector>
+#include <memory_resource>
 #include <array>
 #include <stdexcept>
 #include <algorithm>
@@ -13,9 +14,11 @@ namespace ofc {
 
     constexpr Card INVALID_CARD = 255;
 
-    // Действие: расстановка карт и карта сброса
+    // Действие: расстановка карт и карта сброса. Контейнеры pmr, чтобы обход мог
+    // размещать списки действий в арене потока (по умолчанию — обычная куча).
     using Placement = std::pair<Card, std::pair<std::string, int>>;
-    using Action = std::pair<std::vector<Placement>, Card>;
+    using Action = std::pair<std::pmr::vector<Placement>, Card>;
+    using ActionList = std::pmr::vector<Action>;
 
     inline int get_rank(Card c) { return c / 4; }
     inline int get_suit(Card c) { return c % 4; }
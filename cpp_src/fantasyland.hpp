@@ -0,0 +1,238 @@
+// mccfr_ofc-main/cpp_src/fantasyland.hpp
+
+#pragma once
+#include "board.hpp"
+#include <omp/Random.h>
+#include <array>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+#include <numeric>
+#include <cmath>
+#include <iostream>
+
+namespace ofc {
+
+    // Лучшая расстановка 13 из 14-17 карт фантазии.
+    struct FantasylandResult {
+        Board board;
+        CardSet discards;
+        int royalty = 0;
+        bool stays_in_fantasyland = false;
+        double score = 0.0;   // роялти + ценность повторной фантазии
+        bool valid = false;
+    };
+
+    // Движок расстановки фантазии: максимизирует роялти без фола с учетом повторной фантазии
+    // (трипс наверху или каре+ внизу). Перебор: низ -> середина -> верх по отсортированным
+    // по роялти 5-карточным подмножествам с отсечением по верхней оценке счета.
+    class FantasylandSolver {
+    public:
+        explicit FantasylandSolver(const HandEvaluator& evaluator, double repeat_bonus = 15.0)
+            : evaluator_(evaluator), repeat_bonus_(repeat_bonus) {}
+
+        inline FantasylandResult solve(const CardSet& cards) const {
+            const int n = cards.size();
+            if (n < 13 || n > 17) throw std::invalid_argument("Fantasyland hand must contain 13..17 cards");
+
+            // Все 5-карточные подмножества: маска по индексам карт, сила и роялти как низа/середины.
+            std::vector<Subset> subsets;
+            subsets.reserve(6188);
+            for (int a = 0; a < n; ++a) for (int b = a + 1; b < n; ++b) for (int c = b + 1; c < n; ++c)
+            for (int d = c + 1; d < n; ++d) for (int e = d + 1; e < n; ++e) {
+                omp::Hand h = omp::Hand::empty() + omp::Hand(cards[a]) + omp::Hand(cards[b]) +
+                              omp::Hand(cards[c]) + omp::Hand(cards[d]) + omp::Hand(cards[e]);
+                Subset s;
+                s.mask = (1u << a) | (1u << b) | (1u << c) | (1u << d) | (1u << e);
+                s.strength = evaluator_.strength(h);
+                s.middle_royalty = evaluator_.get_royalty_by_strength(s.strength, true);
+                s.bottom_score = evaluator_.get_royalty_by_strength(s.strength, false) +
+                                 (s.strength >= (int)omp::FOUR_OF_A_KIND ? repeat_bonus_ : 0.0);
+                subsets.push_back(s);
+            }
+
+            std::vector<const Subset*> by_bottom(subsets.size()), by_middle(subsets.size());
+            for (size_t i = 0; i < subsets.size(); ++i) by_bottom[i] = by_middle[i] = &subsets[i];
+            std::sort(by_bottom.begin(), by_bottom.end(), [](const Subset* x, const Subset* y) {
+                return x->bottom_score != y->bottom_score ? x->bottom_score > y->bottom_score : x->strength > y->strength;
+            });
+            std::sort(by_middle.begin(), by_middle.end(), [](const Subset* x, const Subset* y) {
+                return x->middle_royalty != y->middle_royalty ? x->middle_royalty > y->middle_royalty : x->strength > y->strength;
+            });
+
+            // Все тройки для верха, отсортированные по убыванию вклада: с учетом повторной фантазии
+            // за трипс и без нее (когда повтор уже дает каре внизу).
+            std::vector<TopSubset> tops;
+            tops.reserve(680);
+            for (int a = 0; a < n; ++a) for (int b = a + 1; b < n; ++b) for (int c = b + 1; c < n; ++c) {
+                omp::Hand h = omp::Hand::empty() + omp::Hand(cards[a]) + omp::Hand(cards[b]) + omp::Hand(cards[c]);
+                TopSubset t;
+                t.mask = (1u << a) | (1u << b) | (1u << c);
+                t.strength = evaluator_.strength(h);
+                t.royalty = evaluator_.get_top_royalty(cards[a], cards[b], cards[c]);
+                t.score = top_score(cards[a], cards[b], cards[c]);
+                tops.push_back(t);
+            }
+            std::vector<const TopSubset*> tops_by_score(tops.size()), tops_by_royalty(tops.size());
+            for (size_t i = 0; i < tops.size(); ++i) tops_by_score[i] = tops_by_royalty[i] = &tops[i];
+            std::sort(tops_by_score.begin(), tops_by_score.end(), [](const TopSubset* x, const TopSubset* y) { return x->score > y->score; });
+            std::sort(tops_by_royalty.begin(), tops_by_royalty.end(), [](const TopSubset* x, const TopSubset* y) { return x->royalty > y->royalty; });
+
+            const double max_top_score = tops_by_score.empty() ? 0.0 : tops_by_score.front()->score;
+            const int max_middle_royalty = by_middle.empty() ? 0 : by_middle.front()->middle_royalty;
+
+            FantasylandResult best;
+            double best_score = -1.0;
+            uint32_t best_masks[3] = {0, 0, 0};
+
+            for (const Subset* bot : by_bottom) {
+                if (bot->bottom_score + max_middle_royalty + max_top_score <= best_score) break;
+
+                // Повторная фантазия засчитывается один раз: если ее уже дает каре внизу, трипс наверху ее не добавляет.
+                const bool bottom_repeats = bot->strength >= (int)omp::FOUR_OF_A_KIND;
+                const auto& top_order = bottom_repeats ? tops_by_royalty : tops_by_score;
+                auto top_value = [bottom_repeats](const TopSubset* t) { return bottom_repeats ? (double)t->royalty : t->score; };
+
+                // Оценки для этого низа: середина не сильнее низа, значит и ее роялти не выше роялти
+                // такой же руки в середине; верх — лучшая тройка из оставшихся карт не сильнее низа.
+                const int middle_royalty_cap = evaluator_.get_royalty_by_strength(bot->strength, true);
+                double bottom_top_bound = -1.0;
+                for (const TopSubset* t : top_order) {
+                    if (!(t->mask & bot->mask) && t->strength <= bot->strength) { bottom_top_bound = top_value(t); break; }
+                }
+                if (bottom_top_bound < 0) continue;
+                if (bot->bottom_score + middle_royalty_cap + bottom_top_bound <= best_score) continue;
+
+                for (const Subset* mid : by_middle) {
+                    if (bot->bottom_score + mid->middle_royalty + bottom_top_bound <= best_score) break;
+                    if ((mid->mask & bot->mask) || mid->strength > bot->strength) continue;
+
+                    // Первая подходящая тройка в отсортированном списке — лучший верх для этой пары.
+                    const uint32_t used = bot->mask | mid->mask;
+                    const TopSubset* best_top = nullptr;
+                    for (const TopSubset* t : top_order) {
+                        if (!(t->mask & used) && t->strength <= mid->strength) { best_top = t; break; }
+                    }
+                    if (!best_top) continue;
+
+                    double score = bot->bottom_score + mid->middle_royalty + top_value(best_top);
+                    if (score > best_score) {
+                        best_score = score;
+                        best_masks[0] = best_top->mask;
+                        best_masks[1] = mid->mask;
+                        best_masks[2] = bot->mask;
+                    }
+                }
+            }
+
+            if (best_score < 0) return best;
+            int ti = 0, mi = 0, bi = 0;
+            for (int i = 0; i < n; ++i) {
+                uint32_t bit = 1u << i;
+                if (best_masks[0] & bit) best.board.top[ti++] = cards[i];
+                else if (best_masks[1] & bit) best.board.middle[mi++] = cards[i];
+                else if (best_masks[2] & bit) best.board.bottom[bi++] = cards[i];
+                else best.discards.push_back(cards[i]);
+            }
+            best.royalty = best.board.get_total_royalty(evaluator_);
+            best.stays_in_fantasyland = stays_in_fantasyland(best.board);
+            best.score = best_score;
+            best.valid = true;
+            return best;
+        }
+
+        // Пакетное решение: руки независимы, распределяем их по потокам.
+        inline std::vector<FantasylandResult> solve_batch(const std::vector<CardSet>& hands) const {
+            std::vector<FantasylandResult> results(hands.size());
+            #pragma omp parallel for schedule(dynamic)
+            for (int i = 0; i < (int)hands.size(); ++i) {
+                results[i] = solve(hands[i]);
+            }
+            return results;
+        }
+
+        inline bool stays_in_fantasyland(const Board& board) const {
+            int top_rank_0 = get_rank(board.top[0]);
+            bool top_trips = top_rank_0 == get_rank(board.top[1]) && top_rank_0 == get_rank(board.top[2]);
+            omp::Hand bot = omp::Hand::empty();
+            for (Card c : board.bottom) bot += omp::Hand(c);
+            return top_trips || evaluator_.strength(bot) >= (int)omp::FOUR_OF_A_KIND;
+        }
+
+        double get_repeat_bonus() const { return repeat_bonus_; }
+
+    private:
+        struct Subset {
+            uint32_t mask;
+            int strength;
+            int middle_royalty;
+            double bottom_score;
+        };
+
+        struct TopSubset {
+            uint32_t mask;
+            int strength;
+            int royalty;
+            double score;
+        };
+
+        inline double top_score(Card c0, Card c1, Card c2) const {
+            bool trips = get_rank(c0) == get_rank(c1) && get_rank(c1) == get_rank(c2);
+            return evaluator_.get_top_royalty(c0, c1, c2) + (trips ? repeat_bonus_ : 0.0);
+        }
+
+        const HandEvaluator& evaluator_;
+        double repeat_bonus_;
+    };
+
+    // Офлайн-оценка ценности фантазии Монте-Карло по движку расстановки: для каждого уровня
+    // 14-17 карт и профиля мертвых карт — средний счет (роялти + повтор) и его стандартная ошибка.
+    // Ценность повтора берется из уровня 14 карт и уточняется проходами неподвижной точки.
+    inline FantasylandTable estimate_fantasyland_table(const HandEvaluator& evaluator, int samples_per_tier,
+                                                       const std::vector<int>& dead_counts, uint64_t seed,
+                                                       int fixed_point_rounds = 2) {
+        if (samples_per_tier <= 0) throw std::invalid_argument("samples_per_tier must be positive");
+        FantasylandTable table(dead_counts);
+        double repeat_value = evaluator.get_fantasyland_bonus(FantasylandTable::MIN_CARDS);
+        omp::XoroShiro128Plus rng(seed);
+
+        for (int round = 0; round < std::max(1, fixed_point_rounds); ++round) {
+            FantasylandSolver solver(evaluator, repeat_value);
+            for (int profile = 0; profile < table.num_profiles(); ++profile) {
+                const int dead = table.get_dead_count(profile);
+                for (int n = FantasylandTable::MIN_CARDS; n < FantasylandTable::MIN_CARDS + FantasylandTable::NUM_TIERS; ++n) {
+                    if (dead + n > 52) throw std::invalid_argument("Too many dead cards for fantasyland tier");
+                    std::vector<CardSet> hands(samples_per_tier);
+                    CardSet deck(52);
+                    for (auto& hand : hands) {
+                        // Частичный Фишер-Йейтс: первые dead карт выбывают, следующие n — рука фантазии.
+                        std::iota(deck.begin(), deck.end(), 0);
+                        for (int i = 0; i < dead + n; ++i) std::swap(deck[i], deck[i + rng() % (52 - i)]);
+                        hand.assign(deck.begin() + dead, deck.begin() + dead + n);
+                    }
+                    auto results = solver.solve_batch(hands);
+                    double sum = 0.0, sum_sq = 0.0;
+                    for (const auto& r : results) { sum += r.score; sum_sq += r.score * r.score; }
+                    double mean = sum / samples_per_tier;
+                    double variance = std::max(0.0, sum_sq / samples_per_tier - mean * mean);
+                    table.set(n, profile, (float)mean, (float)std::sqrt(variance / samples_per_tier));
+                }
+            }
+            repeat_value = table.get(FantasylandTable::MIN_CARDS);
+        }
+        return table;
+    }
+
+    inline void build_fantasyland_table(const std::string& path, int samples_per_tier,
+                                        const std::vector<int>& dead_counts, uint64_t seed) {
+        HandEvaluator evaluator;
+        FantasylandTable table = estimate_fantasyland_table(evaluator, samples_per_tier, dead_counts, seed);
+        table.save(path);
+        for (int profile = 0; profile < table.num_profiles(); ++profile) {
+            for (int n = FantasylandTable::MIN_CARDS; n < FantasylandTable::MIN_CARDS + FantasylandTable::NUM_TIERS; ++n) {
+                std::cout << "FL " << n << " cards, " << table.get_dead_count(profile) << " dead: "
+                          << table.get(n, profile) << " +- " << table.get_std_error(n, profile) << std::endl;
+            }
+        }
+    }
+}
@@ -0,0 +1,87 @@
+// mccfr_ofc-main/cpp_src/fantasyland_table.hpp
+
+#pragma once
+#include <array>
+#include <vector>
+#include <string>
+#include <fstream>
+#include <stdexcept>
+#include <cstdint>
+
+namespace ofc {
+
+    // Таблица ожидаемой ценности фантазии: [уровень 14/15/16/17 карт][профиль мертвых карт].
+    // Профиль — число заранее выбывших из колоды карт; профиль 0 используется в get_payoffs.
+    // Строится офлайн Монте-Карло по FantasylandSolver (см. build_fantasyland_table).
+    class FantasylandTable {
+    public:
+        static constexpr int NUM_TIERS = 4;
+        static constexpr int MIN_CARDS = 14;
+        static constexpr uint32_t FILE_MAGIC = 0x4C46434F; // "OCFL"
+        static constexpr uint32_t FILE_VERSION = 1;
+
+        // По умолчанию — прежние фиксированные бонусы QQ/KK/AA/трипс, один профиль без мертвых карт.
+        FantasylandTable() : dead_counts_{0}, values_{15.0f, 20.0f, 25.0f, 30.0f}, std_errors_(NUM_TIERS, 0.0f) {}
+
+        FantasylandTable(const std::vector<int>& dead_counts)
+            : dead_counts_(dead_counts), values_(NUM_TIERS * dead_counts.size(), 0.0f),
+              std_errors_(NUM_TIERS * dead_counts.size(), 0.0f) {
+            if (dead_counts_.empty()) throw std::invalid_argument("Fantasyland table needs at least one profile");
+        }
+
+        inline float get(int card_count, int profile = 0) const {
+            if (card_count < MIN_CARDS || card_count >= MIN_CARDS + NUM_TIERS) return 0.0f;
+            return values_[index(card_count, profile)];
+        }
+
+        inline void set(int card_count, int profile, float value, float std_error = 0.0f) {
+            if (card_count < MIN_CARDS || card_count >= MIN_CARDS + NUM_TIERS || profile < 0 || profile >= num_profiles()) {
+                throw std::invalid_argument("Fantasyland card count must be 14..17");
+            }
+            values_[index(card_count, profile)] = value;
+            std_errors_[index(card_count, profile)] = std_error;
+        }
+
+        inline float get_std_error(int card_count, int profile = 0) const { return std_errors_[index(card_count, profile)]; }
+        inline int num_profiles() const { return (int)dead_counts_.size(); }
+        inline int get_dead_count(int profile) const { return dead_counts_[profile]; }
+
+        inline void save(const std::string& path) const {
+            std::ofstream out(path, std::ios::binary);
+            if (!out) throw std::runtime_error("Cannot open file for writing: " + path);
+            uint32_t header[4] = {FILE_MAGIC, FILE_VERSION, (uint32_t)NUM_TIERS, (uint32_t)dead_counts_.size()};
+            out.write(reinterpret_cast<const char*>(header), sizeof(header));
+            out.write(reinterpret_cast<const char*>(dead_counts_.data()), dead_counts_.size() * sizeof(int));
+            out.write(reinterpret_cast<const char*>(values_.data()), values_.size() * sizeof(float));
+            out.write(reinterpret_cast<const char*>(std_errors_.data()), std_errors_.size() * sizeof(float));
+        }
+
+        inline void load(const std::string& path) {
+            std::ifstream in(path, std::ios::binary);
+            if (!in) throw std::runtime_error("Cannot open fantasyland table: " + path);
+            uint32_t header[4];
+            in.read(reinterpret_cast<char*>(header), sizeof(header));
+            if (in.fail() || header[0] != FILE_MAGIC || header[1] != FILE_VERSION || header[2] != (uint32_t)NUM_TIERS || header[3] == 0) {
+                throw std::runtime_error("Invalid fantasyland table: " + path);
+            }
+            std::vector<int> dead_counts(header[3]);
+            std::vector<float> values(NUM_TIERS * header[3]), std_errors(NUM_TIERS * header[3]);
+            in.read(reinterpret_cast<char*>(dead_counts.data()), dead_counts.size() * sizeof(int));
+            in.read(reinterpret_cast<char*>(values.data()), values.size() * sizeof(float));
+            in.read(reinterpret_cast<char*>(std_errors.data()), std_errors.size() * sizeof(float));
+            if (in.fail()) throw std::runtime_error("Truncated fantasyland table: " + path);
+            dead_counts_ = std::move(dead_counts);
+            values_ = std::move(values);
+            std_errors_ = std::move(std_errors);
+        }
+
+    private:
+        inline size_t index(int card_count, int profile) const {
+            return (size_t)profile * NUM_TIERS + (card_count - MIN_CARDS);
+        }
+
+        std::vector<int> dead_counts_;
+        std::vector<float> values_;
+        std::vector<float> std_errors_;
+    };
+}
@@ -0,0 +1,125 @@
+// mccfr_ofc-main/cpp_src/foul_analysis.hpp
+
+#pragma once
+#include "board.hpp"
+#include <omp/Random.h>
+#include <array>
+#include <algorithm>
+
+namespace ofc {
+
+    // Множество карт как битовая маска: бит c соответствует карте c.
+    using CardMask = uint64_t;
+    constexpr CardMask FULL_DECK_MASK = (CardMask(1) << 52) - 1;
+
+    inline CardMask card_bit(Card c) { return CardMask(1) << c; }
+
+    template<size_t N>
+    inline CardMask row_mask(const std::array<Card, N>& row) {
+        CardMask m = 0;
+        for (Card c : row) if (c != INVALID_CARD) m |= card_bit(c);
+        return m;
+    }
+
+    inline CardMask board_mask(const Board& b) {
+        return row_mask(b.top) | row_mask(b.middle) | row_mask(b.bottom);
+    }
+
+    // Границы силы ряда по шкале omp (больше — сильнее) по всем дозаполнениям живыми картами.
+    struct RowBounds {
+        int min_strength;
+        int max_strength;
+    };
+
+    // Точный перебор дозаполнений делаем только для почти полных рядов (до C(47,2) вариантов).
+    // Для остальных: минимум — сила уже стоящих карт, максимум — не ограничен.
+    constexpr int FOUL_EXACT_FREE_SLOTS = 2;
+    constexpr int MAX_HAND_STRENGTH = 0xFFFF;
+
+    template<size_t N>
+    inline RowBounds get_row_bounds(const std::array<Card, N>& row, CardMask live, const HandEvaluator& evaluator) {
+        omp::Hand partial = omp::Hand::empty();
+        int free_slots = 0;
+        for (Card c : row) {
+            if (c == INVALID_CARD) free_slots++;
+            else partial += omp::Hand(c);
+        }
+        if (free_slots == 0) {
+            int s = evaluator.strength(partial);
+            return {s, s};
+        }
+        if (free_slots > FOUL_EXACT_FREE_SLOTS) {
+            return {evaluator.strength(partial), MAX_HAND_STRENGTH};
+        }
+
+        std::array<Card, 52> live_cards;
+        int num_live = 0;
+        for (Card c = 0; c < 52; ++c) if (live & card_bit(c)) live_cards[num_live++] = c;
+        if (num_live < free_slots) return {evaluator.strength(partial), MAX_HAND_STRENGTH};
+
+        RowBounds bounds = {MAX_HAND_STRENGTH, 0};
+        for (int i = 0; i < num_live; ++i) {
+            omp::Hand h1 = partial + omp::Hand(live_cards[i]);
+            if (free_slots == 1) {
+                int s = evaluator.strength(h1);
+                bounds.min_strength = std::min(bounds.min_strength, s);
+                bounds.max_strength = std::max(bounds.max_strength, s);
+                continue;
+            }
+            for (int j = i + 1; j < num_live; ++j) {
+                int s = evaluator.strength(h1 + omp::Hand(live_cards[j]));
+                bounds.min_strength = std::min(bounds.min_strength, s);
+                bounds.max_strength = std::max(bounds.max_strength, s);
+            }
+        }
+        return bounds;
+    }
+
+    // Гарантированный фол: при любом дозаполнении верх сильнее середины или середина сильнее низа.
+    // Проверка консервативная (ряды оцениваются независимо), ложных срабатываний не дает.
+    inline bool is_certain_foul(const Board& board, CardMask live, const HandEvaluator& evaluator) {
+        RowBounds mid = get_row_bounds(board.middle, live, evaluator);
+        RowBounds top = get_row_bounds(board.top, live, evaluator);
+        if (top.min_strength > mid.max_strength) return true;
+        RowBounds bot = get_row_bounds(board.bottom, live, evaluator);
+        return mid.min_strength > bot.max_strength;
+    }
+
+    // Оценка вероятности фола при случайном дозаполнении свободных слотов живыми картами.
+    inline double estimate_foul_probability(const Board& board, CardMask live, const HandEvaluator& evaluator,
+                                            omp::XoroShiro128Plus& rng, int samples) {
+        std::array<Card, 52> live_cards;
+        int num_live = 0;
+        for (Card c = 0; c < 52; ++c) if (live & card_bit(c)) live_cards[num_live++] = c;
+
+        omp::Hand top = omp::Hand::empty(), mid = omp::Hand::empty(), bot = omp::Hand::empty();
+        int top_free = 0, mid_free = 0, bot_free = 0;
+        for (Card c : board.top) if (c == INVALID_CARD) top_free++; else top += omp::Hand(c);
+        for (Card c : board.middle) if (c == INVALID_CARD) mid_free++; else mid += omp::Hand(c);
+        for (Card c : board.bottom) if (c == INVALID_CARD) bot_free++; else bot += omp::Hand(c);
+
+        int total_free = top_free + mid_free + bot_free;
+        if (total_free == 0) {
+            int t = evaluator.strength(top), m = evaluator.strength(mid), b = evaluator.strength(bot);
+            return (t > m || m > b) ? 1.0 : 0.0;
+        }
+        if (num_live < total_free || samples <= 0) return 0.0;
+
+        int fouls = 0;
+        for (int s = 0; s < samples; ++s) {
+            // Частичный Фишер-Йейтс: первые total_free карт — случайная выборка без повторов.
+            for (int i = 0; i < total_free; ++i) {
+                int j = i + (int)(rng() % (uint64_t)(num_live - i));
+                std::swap(live_cards[i], live_cards[j]);
+            }
+            omp::Hand t = top, m = mid, b = bot;
+            int k = 0;
+            for (int i = 0; i < top_free; ++i) t += omp::Hand(live_cards[k++]);
+            for (int i = 0; i < mid_free; ++i) m += omp::Hand(live_cards[k++]);
+            for (int i = 0; i < bot_free; ++i) b += omp::Hand(live_cards[k++]);
+            int ts = evaluator.strength(t), ms = evaluator.strength(m), bs = evaluator.strength(b);
+            if (ts > ms || ms > bs) fouls++;
+        }
+        return (double)fouls / samples;
+    }
+}
@@ -2,6 +2,7 @@
 
 #pragma once
 #include "board.hpp"
+#include "foul_analysis.hpp"
 #include <vector>
 #include <random>
 #include <numeric>
@@ -9,13 +10,16 @@
 #include <iostream>
 #include <functional>
 #include <map>
+#include <array>
+#include <memory_resource>
 
 namespace ofc {
 
     class GameState {
     public:
-        GameState(int num_players = 2, int dealer_pos = -1)
-            : num_players_(num_players), street_(1), boards_(num_players), discards_(num_players) {
+        // Контейнеры состояния берут память из mr: обход размещает состояния в арене потока.
+        GameState(int num_players = 2, int dealer_pos = -1, std::pmr::memory_resource* mr = std::pmr::get_default_resource())
+            : num_players_(num_players), street_(1), boards_(num_players, mr), discards_(num_players, mr), deck_(mr), dealt_cards_(mr) {
             
             deck_.resize(52);
             std::iota(deck_.begin(), deck_.end(), 0);
@@ -33,21 +37,84 @@ namespace ofc {
         }
 
         GameState(const GameState& other) = default;
+        GameState(GameState&& other) = default;
+        GameState& operator=(const GameState& other) = default;
+        GameState& operator=(GameState&& other) = default;
 
+        GameState(const GameState& other, std::pmr::memory_resource* mr)
+            : num_players_(other.num_players_), street_(other.street_), dealer_pos_(other.dealer_pos_),
+              current_player_(other.current_player_), boards_(other.boards_, mr), discards_(other.discards_, mr),
+              deck_(other.deck_, mr), dealt_cards_(other.dealt_cards_, mr), foul_verdicts_(other.foul_verdicts_) {}
+
+        // ИСПРАВЛЕНО: игра заканчивается, когда обе доски заполнены (улица 5 сыграна дилером),
+        // а не когда заполнена доска первого игрока — иначе второй не доигрывал последнюю улицу.
         inline bool is_terminal() const {
-            return street_ > 5 || boards_[0].get_card_count() == 13;
+            return street_ > 5;
         }
 
         inline std::pair<float, float> get_payoffs(const HandEvaluator& evaluator) const {
-            const int FANTASY_BONUS_QQ = 15, FANTASY_BONUS_KK = 20, FANTASY_BONUS_AA = 25, FANTASY_BONUS_TRIPS = 30;
+            return get_payoffs_given_fouls(evaluator, boards_[0].is_foul(evaluator), boards_[1].is_foul(evaluator));
+        }
+
+        // Карты, которые еще могут попасть на доску игрока с его точки зрения:
+        // все, кроме выложенных на обе доски, его сбросов и чужой раздачи.
+        inline CardMask get_live_cards(int player_idx) const {
+            CardMask dead = 0;
+            for (const Board& b : boards_) dead |= board_mask(b);
+            for (Card c : discards_[player_idx]) dead |= card_bit(c);
+            if (player_idx != current_player_) for (Card c : dealt_cards_) dead |= card_bit(c);
+            return FULL_DECK_MASK & ~dead;
+        }
+
+        // Карты, которые могут дополнить доску игрока, если не учитывать чужие карты:
+        // все, кроме его доски и его сбросов. Зависит только от его собственных ходов.
+        inline CardMask get_board_live_cards(int player_idx) const {
+            CardMask dead = board_mask(boards_[player_idx]);
+            for (Card c : discards_[player_idx]) dead |= card_bit(c);
+            return FULL_DECK_MASK & ~dead;
+        }
+
+        // Вердикт считается по доске и сбросам игрока (без карт соперника — расхождение с полным
+        // набором живых карт единичное) и кэшируется до его следующего хода; гарантированный фол
+        // остается таковым и после хода. Кэш заполняется владельцем состояния до того, как
+        // состояние читают задачи других потоков.
+        inline bool is_certain_foul(int player_idx, const HandEvaluator& evaluator) const {
+            int8_t& verdict = foul_verdicts_[player_idx];
+            if (verdict == FOUL_UNKNOWN) {
+                verdict = ofc::is_certain_foul(boards_[player_idx], get_board_live_cards(player_idx), evaluator)
+                        ? FOUL_CERTAIN : FOUL_POSSIBLE;
+            }
+            return verdict == FOUL_CERTAIN;
+        }
+
+        inline double estimate_foul_probability(int player_idx, const HandEvaluator& evaluator,
+                                                omp::XoroShiro128Plus& rng, int samples) const {
+            return ofc::estimate_foul_probability(boards_[player_idx], get_live_cards(player_idx), evaluator, rng, samples);
+        }
+
+        // Досрочный исход: если фол одного игрока уже неизбежен, а доска соперника заполнена
+        // (или соперник тоже гарантированно фолит), выплаты известны без дальнейшей игры.
+        inline bool get_early_payoffs(const HandEvaluator& evaluator, std::pair<float, float>& out_payoffs) const {
+            bool p1_foul = is_certain_foul(0, evaluator);
+            bool p2_foul = is_certain_foul(1, evaluator);
+            if (p1_foul && p2_foul) { out_payoffs = {0.0f, 0.0f}; return true; }
+            if (p1_foul && boards_[1].get_card_count() == 13) {
+                out_payoffs = get_payoffs_given_fouls(evaluator, true, boards_[1].is_foul(evaluator));
+                return true;
+            }
+            if (p2_foul && boards_[0].get_card_count() == 13) {
+                out_payoffs = get_payoffs_given_fouls(evaluator, boards_[0].is_foul(evaluator), true);
+                return true;
+            }
+            return false;
+        }
+
+        inline std::pair<float, float> get_payoffs_given_fouls(const HandEvaluator& evaluator, bool p1_foul, bool p2_foul) const {
             const int SCOOP_BONUS = 3;
 
             const Board& p1_board = boards_[0];
             const Board& p2_board = boards_[1];
 
-            bool p1_foul = p1_board.is_foul(evaluator);
-            bool p2_foul = p2_board.is_foul(evaluator);
-
             int p1_royalty = p1_foul ? 0 : p1_board.get_total_royalty(evaluator);
             int p2_royalty = p2_foul ? 0 : p2_board.get_total_royalty(evaluator);
 
@@ -56,65 +123,51 @@ namespace ofc {
             if (p2_foul) return {(float)(SCOOP_BONUS + p1_royalty), -(float)(SCOOP_BONUS + p1_royalty)};
 
             int line_score = 0;
-            // УЛУЧШЕНО: Используем новый API для get_row_cards, чтобы избежать лишних аллокаций
-            CardSet p1_top, p1_mid, p1_bot, p2_top, p2_mid, p2_bot;
-            p1_board.get_row_cards("top", p1_top);
-            p1_board.get_row_cards("middle", p1_mid);
-            p1_board.get_row_cards("bottom", p1_bot);
-            p2_board.get_row_cards("top", p2_top);
-            p2_board.get_row_cards("middle", p2_mid);
-            p2_board.get_row_cards("bottom", p2_bot);
-
-            if (evaluator.evaluate(p1_top) < evaluator.evaluate(p2_top)) line_score++; else line_score--;
-            if (evaluator.evaluate(p1_mid) < evaluator.evaluate(p2_mid)) line_score++; else line_score--;
-            if (evaluator.evaluate(p1_bot) < evaluator.evaluate(p2_bot)) line_score++; else line_score--;
+            // УЛУЧШЕНО: доски здесь полные, ряды оцениваются прямо из массивов без копий.
+            if (evaluator.evaluate(p1_board.top.data(), 3) < evaluator.evaluate(p2_board.top.data(), 3)) line_score++; else line_score--;
+            if (evaluator.evaluate(p1_board.middle.data(), 5) < evaluator.evaluate(p2_board.middle.data(), 5)) line_score++; else line_score--;
+            if (evaluator.evaluate(p1_board.bottom.data(), 5) < evaluator.evaluate(p2_board.bottom.data(), 5)) line_score++; else line_score--;
 
             if (abs(line_score) == 3) line_score = (line_score > 0) ? SCOOP_BONUS : -SCOOP_BONUS;
             
             float p1_total = (float)(line_score + p1_royalty - p2_royalty);
 
-            if (p1_board.qualifies_for_fantasyland(evaluator)) {
-                int fc = p1_board.get_fantasyland_card_count(evaluator);
-                if (fc == 14) p1_total += FANTASY_BONUS_QQ; else if (fc == 15) p1_total += FANTASY_BONUS_KK;
-                else if (fc == 16) p1_total += FANTASY_BONUS_AA; else if (fc == 17) p1_total += FANTASY_BONUS_TRIPS;
-            }
-            if (p2_board.qualifies_for_fantasyland(evaluator)) {
-                int fc = p2_board.get_fantasyland_card_count(evaluator);
-                if (fc == 14) p1_total -= FANTASY_BONUS_QQ; else if (fc == 15) p1_total -= FANTASY_BONUS_KK;
-                else if (fc == 16) p1_total -= FANTASY_BONUS_AA; else if (fc == 17) p1_total -= FANTASY_BONUS_TRIPS;
-            }
+            // Ценность фантазии берется из оценщика (по умолчанию — прежние фиксированные бонусы).
+            p1_total += evaluator.get_fantasyland_bonus(p1_board.get_fantasyland_card_count(evaluator));
+            p1_total -= evaluator.get_fantasyland_bonus(p2_board.get_fantasyland_card_count(evaluator));
             return {p1_total, -p1_total};
         }
 
-        inline std::vector<Action> get_legal_actions() const {
-            std::vector<Action> actions;
+        inline ActionList get_legal_actions(std::pmr::memory_resource* mr = std::pmr::get_default_resource()) const {
+            ActionList actions(mr);
             if (is_terminal()) return actions;
 
-            CardSet cards_to_place;
-            Card discarded = INVALID_CARD;
-
+            const int free_slots = 13 - boards_[current_player_].get_card_count();
             if (street_ == 1) {
-                cards_to_place = dealt_cards_;
-            } else {
-                // На улицах 2-5 мы должны выбрать 2 из 3 карт.
-                // Генерируем все 3 комбинации.
-                for (int i = 0; i < 3; ++i) {
-                    CardSet current_placement_cards;
-                    Card current_discarded = dealt_cards_[i];
-                    for (int j = 0; j < 3; ++j) {
-                        if (i != j) current_placement_cards.push_back(dealt_cards_[j]);
-                    }
-                    generate_all_placements(current_placement_cards, current_discarded, actions);
-                }
+                // Размещения 5 карт по свободным слотам: free!/(free-5)!.
+                size_t count = 1;
+                for (int i = 0; i < (int)dealt_cards_.size(); ++i) count *= (size_t)std::max(0, free_slots - i);
+                actions.reserve(count);
+                generate_all_placements(dealt_cards_.data(), dealt_cards_.size(), INVALID_CARD, actions);
                 return actions;
             }
-            
-            generate_all_placements(cards_to_place, discarded, actions);
+
+            // На улицах 2-5 мы должны выбрать 2 из 3 карт.
+            // Генерируем все 3 комбинации.
+            actions.reserve((size_t)3 * std::max(0, free_slots * (free_slots - 1)));
+            for (int i = 0; i < 3; ++i) {
+                std::array<Card, 2> current_placement_cards;
+                int n = 0;
+                for (int j = 0; j < 3; ++j) {
+                    if (i != j) current_placement_cards[n++] = dealt_cards_[j];
+                }
+                generate_all_placements(current_placement_cards.data(), 2, dealt_cards_[i], actions);
+            }
             return actions;
         }
 
-        inline GameState apply_action(const Action& action) const {
-            GameState next_state(*this);
+        inline GameState apply_action(const Action& action, std::pmr::memory_resource* mr = std::pmr::get_default_resource()) const {
+            GameState next_state(*this, mr);
             const auto& placements = action.first;
             const Card& discarded_card = action.second;
 
@@ -129,6 +182,8 @@ namespace ofc {
             if (discarded_card != INVALID_CARD) {
                 next_state.discards_[current_player_].push_back(discarded_card);
             }
+            int8_t& verdict = next_state.foul_verdicts_[current_player_];
+            if (verdict != FOUL_CERTAIN) verdict = FOUL_UNKNOWN;
 
             if (next_state.current_player_ == next_state.dealer_pos_) next_state.street_++;
             next_state.current_player_ = (next_state.current_player_ + 1) % num_players_;
@@ -139,9 +194,11 @@ namespace ofc {
         
         int get_street() const { return street_; }
         int get_current_player() const { return current_player_; }
-        const CardSet& get_dealt_cards() const { return dealt_cards_; }
+        const std::pmr::vector<Card>& get_dealt_cards() const { return dealt_cards_; }
         const Board& get_player_board(int player_idx) const { return boards_[player_idx]; }
         const Board& get_opponent_board(int player_idx) const { return boards_[(player_idx + 1) % num_players_]; }
+        const std::pmr::vector<Card>& get_discards(int player_idx) const { return discards_[player_idx]; }
+        int get_dealer_pos() const { return dealer_pos_; }
 
     private:
         inline void deal_cards() {
@@ -158,56 +215,84 @@ namespace ofc {
         // из-за огромного количества комбинаций в "Ананасе".
         // Для практического применения может потребоваться более умный метод
         // отсечения или выборки действий (Action Sampling / Pruning).
-        inline void generate_all_placements(const CardSet& cards, Card discarded, std::vector<Action>& actions) const {
+        inline void generate_all_placements(const Card* cards, size_t num_cards, Card discarded, ActionList& actions) const {
+            // УЛУЧШЕНО: слоты и индексы в массивах на стеке, рекурсия без std::function —
+            // единственные аллокации здесь — сами действия в памяти списка.
             const Board& board = boards_[current_player_];
-            std::vector<std::pair<std::string, int>> available_slots;
-            for(int i=0; i<3; ++i) if(board.top[i] == INVALID_CARD) available_slots.push_back({"top", i});
-            for(int i=0; i<5; ++i) if(board.middle[i] == INVALID_CARD) available_slots.push_back({"middle", i});
-            for(int i=0; i<5; ++i) if(board.bottom[i] == INVALID_CARD) available_slots.push_back({"bottom", i});
+            std::array<std::pair<const char*, int>, 13> available_slots;
+            size_t num_slots = 0;
+            for(int i=0; i<3; ++i) if(board.top[i] == INVALID_CARD) available_slots[num_slots++] = {"top", i};
+            for(int i=0; i<5; ++i) if(board.middle[i] == INVALID_CARD) available_slots[num_slots++] = {"middle", i};
+            for(int i=0; i<5; ++i) if(board.bottom[i] == INVALID_CARD) available_slots[num_slots++] = {"bottom", i};
 
-            if (available_slots.size() < cards.size()) return;
+            if (num_slots < num_cards) return;
 
-            std::vector<int> slot_indices(available_slots.size());
-            std::iota(slot_indices.begin(), slot_indices.end(), 0);
+            PlacementGenerator gen{cards, num_cards, discarded, available_slots.data(), num_slots, actions, {}, {}};
+            std::iota(gen.card_indices.begin(), gen.card_indices.begin() + num_cards, 0);
+            gen.combinations(0, num_cards);
+        }
 
-            std::vector<int> card_indices(cards.size());
-            std::iota(card_indices.begin(), card_indices.end(), 0);
+        struct PlacementGenerator {
+            const Card* cards;
+            size_t num_cards;
+            Card discarded;
+            const std::pair<const char*, int>* slots;
+            size_t num_slots;
+            ActionList& actions;
+            std::array<int, 5> card_indices;
+            std::array<int, 5> slot_selection;
 
-            std::vector<int> current_slot_selection(cards.size());
-            
-            std::function<void(int, int)> combinations = 
-                [&](int offset, int k) {
+            inline void combinations(size_t offset, size_t k) {
                 if (k == 0) {
                     // После выбора слотов, генерируем все перестановки карт по этим слотам
                     do {
-                        std::vector<Placement> current_placement;
-                        for(size_t i = 0; i < cards.size(); ++i) {
-                            current_placement.push_back({cards[card_indices[i]], available_slots[current_slot_selection[i]]});
+                        actions.emplace_back();
+                        Action& action = actions.back();
+                        action.first.reserve(num_cards);
+                        for (size_t i = 0; i < num_cards; ++i) {
+                            const auto& slot = slots[slot_selection[i]];
+                            action.first.push_back({cards[card_indices[i]], {slot.first, slot.second}});
                         }
-                        actions.push_back({current_placement, discarded});
-                    } while(std::next_permutation(card_indices.begin(), card_indices.end()));
-                    // Восстанавливаем исходный порядок индексов карт для следующей комбинации слотов
-                    std::iota(card_indices.begin(), card_indices.end(), 0);
+                        action.second = discarded;
+                    } while (std::next_permutation(card_indices.begin(), card_indices.begin() + num_cards));
+                    // После полного цикла next_permutation индексы снова отсортированы.
                     return;
                 }
-                for (size_t i = offset; i <= slot_indices.size() - k; ++i) {
-                    current_slot_selection[cards.size() - k] = slot_indices[i];
+                for (size_t i = offset; i + k <= num_slots; ++i) {
+                    slot_selection[num_cards - k] = (int)i;
                     combinations(i + 1, k - 1);
                 }
-            };
-            
-            combinations(0, cards.size());
-        }
+            }
+        };
 
         int num_players_;
         int street_;
         int dealer_pos_;
         int current_player_;
-        std::vector<Board> boards_;
-        std::vector<CardSet> discards_;
-        CardSet deck_;
-        CardSet dealt_cards_;
+        std::pmr::vector<Board> boards_;
+        std::pmr::vector<std::pmr::vector<Card>> discards_;
+        std::pmr::vector<Card> deck_;
+        std::pmr::vector<Card> dealt_cards_;
+
+        enum : int8_t { FOUL_UNKNOWN = 0, FOUL_POSSIBLE = 1, FOUL_CERTAIN = 2 };
+        mutable std::array<int8_t, 2> foul_verdicts_ = {FOUL_UNKNOWN, FOUL_UNKNOWN};
         
         static std::mt19937 rng_;
     };
+
+    // Случайные позиции для бенчмарков: новые раздачи, доигранные случайными ходами до улицы street.
+    inline std::vector<GameState> sample_positions(int street, int positions, uint64_t seed) {
+        omp::XoroShiro128Plus rng(seed);
+        std::vector<GameState> states;
+        states.reserve(std::max(0, positions));
+        for (int i = 0; i < positions; ++i) {
+            GameState state;
+            while (!state.is_terminal() && state.get_street() < street) {
+                auto actions = state.get_legal_actions();
+                state = state.apply_action(actions[rng() % actions.size()]);
+            }
+            states.push_back(std::move(state));
+        }
+        return states;
+    }
 }
@@ -2,6 +2,7 @@
 
 #pragma once
 #include "card.hpp"
+#include "fantasyland_table.hpp"
 #include <omp/HandEvaluator.h>
 #include <string>
 #include <tuple>
@@ -12,6 +13,8 @@
 
 namespace ofc {
 
+    // rank_value: меньше — сильнее. Единая шкала для рядов из 3 и 5 карт,
+    // поэтому верх можно напрямую сравнивать с серединой.
     struct HandRank {
         int rank_value;
         int hand_class;
@@ -24,6 +27,9 @@ namespace ofc {
 
     class HandEvaluator {
     public:
+        // Верхняя граница шкалы omp: rank_value = RANK_CEIL - сила omp.
+        static constexpr int RANK_CEIL = 1 << 16;
+
         HandEvaluator() {
             class_to_string_map_ = {
                 {1, "Straight Flush"}, {2, "Four of a Kind"}, {3, "Full House"},
@@ -34,22 +40,37 @@ namespace ofc {
         }
 
         inline HandRank evaluate(const CardSet& cards) const {
-            if (cards.size() == 5) {
+            return evaluate(cards.data(), cards.size());
+        }
+
+        // УЛУЧШЕНО: вариант по указателю — ряды доски оцениваются без временных векторов.
+        inline HandRank evaluate(const Card* cards, size_t count) const {
+            if (count == 5) {
                 omp::Hand h = omp::Hand::empty();
-                for (Card c : cards) h += omp::Hand(c);
-                int rank_value = evaluator_5_card_.evaluate(h);
-                int hand_class_omp = rank_value >> 12;
+                for (size_t i = 0; i < count; ++i) h += omp::Hand(cards[i]);
+                int strength = evaluator_5_card_.evaluate(h);
+                int hand_class_omp = strength >> 12;
                 int hand_class = (hand_class_omp == 0) ? 9 : 10 - hand_class_omp;
-                return {rank_value, hand_class, class_to_string_map_.at(hand_class)};
+                return {RANK_CEIL - strength, hand_class, class_to_string_map_.at(hand_class)};
             }
-            if (cards.size() == 3) {
+            if (count == 3) {
                 auto it = evaluator_3_card_lookup_.find(get_3_card_key(cards));
                 if (it != evaluator_3_card_lookup_.end()) return it->second;
             }
-            return {9999, 9, "Invalid"};
+            return {RANK_CEIL, 9, "Invalid"};
+        }
+
+        // Сила неполной руки (0..7 карт) по шкале omp: больше — сильнее.
+        // Недостающая карта считается худшим кикером, поэтому добавление карт силу не уменьшает.
+        inline int strength(const omp::Hand& hand) const {
+            return evaluator_5_card_.evaluate(hand);
         }
 
         inline int get_royalty(const CardSet& cards, const std::string& row_name) const {
+            return get_royalty(cards.data(), cards.size(), row_name);
+        }
+
+        inline int get_royalty(const Card* cards, size_t count, const std::string& row_name) const {
             // УЛУЧШЕНО: Замена std::map на более быстрые структуры данных
             static const std::unordered_map<std::string, int> ROYALTY_BOTTOM = {{"Straight", 2}, {"Flush", 4}, {"Full House", 6}, {"Four of a Kind", 10}, {"Straight Flush", 15}, {"Royal Flush", 25}};
             static const std::unordered_map<std::string, int> ROYALTY_MIDDLE = {{"Three of a Kind", 2}, {"Straight", 4}, {"Flush", 8}, {"Full House", 12}, {"Four of a Kind", 20}, {"Straight Flush", 30}, {"Royal Flush", 50}};
@@ -58,15 +79,15 @@ namespace ofc {
             // Трипсы от 222 (ранг 0) до AAA (ранг 12).
             static const std::array<int, 13> ROYALTY_TOP_TRIPS = {10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20, 21, 22};
 
-            if (cards.empty()) return 0;
-            HandRank hr = evaluate(cards);
+            if (count == 0) return 0;
+            HandRank hr = evaluate(cards, count);
 
             if (row_name == "top") {
                 if (hr.type_str == "Trips") {
                     int rank = get_rank(cards[0]);
                     if (rank >= 0 && rank < 13) return ROYALTY_TOP_TRIPS[rank];
                 } else if (hr.type_str == "Pair") {
-                    std::vector<int> ranks = {get_rank(cards[0]), get_rank(cards[1]), get_rank(cards[2])};
+                    std::array<int, 3> ranks = {get_rank(cards[0]), get_rank(cards[1]), get_rank(cards[2])};
                     int pair_rank = (ranks[0] == ranks[1] || ranks[0] == ranks[2]) ? ranks[0] : ranks[1];
                     if (pair_rank >= 4 && pair_rank < 13) return ROYALTY_TOP_PAIRS[pair_rank];
                 }
@@ -80,38 +101,77 @@ namespace ofc {
             return 0;
         }
 
+        // Быстрые роялти без строк для переборных движков (значения совпадают с get_royalty).
+        // Индекс — категория omp (сила >> 12): 4 трипс, 5 стрит, 6 флеш, 7 фулл-хаус, 8 каре, 9 стрит-флеш.
+        inline int get_royalty_by_strength(int strength, bool is_middle) const {
+            static constexpr std::array<int, 10> ROYALTY_MIDDLE_BY_CLASS = {0, 0, 0, 0, 2, 4, 8, 12, 20, 30};
+            static constexpr std::array<int, 10> ROYALTY_BOTTOM_BY_CLASS = {0, 0, 0, 0, 0, 2, 4, 6, 10, 15};
+            int omp_class = strength >> 12;
+            if (omp_class < 0 || omp_class > 9) return 0;
+            return is_middle ? ROYALTY_MIDDLE_BY_CLASS[omp_class] : ROYALTY_BOTTOM_BY_CLASS[omp_class];
+        }
+
+        inline int get_top_royalty(Card c0, Card c1, Card c2) const {
+            int r0 = get_rank(c0), r1 = get_rank(c1), r2 = get_rank(c2);
+            if (r0 == r1 && r1 == r2) return 10 + r0;
+            int pair_rank = (r0 == r1 || r0 == r2) ? r0 : (r1 == r2 ? r1 : -1);
+            return pair_rank >= 4 ? pair_rank - 3 : 0;
+        }
+
+        // Ценность фантазии по числу карт (14: QQ, 15: KK, 16: AA, 17: трипс) — O(1) из таблицы.
+        // По умолчанию — прежние фиксированные бонусы; таблицу строит build_fantasyland_table.
+        inline float get_fantasyland_bonus(int card_count) const {
+            return fantasyland_table_.get(card_count);
+        }
+
+        inline void set_fantasyland_bonus(int card_count, float value) {
+            fantasyland_table_.set(card_count, 0, value);
+        }
+
+        inline void load_fantasyland_table(const std::string& path) { fantasyland_table_.load(path); }
+        inline const FantasylandTable& get_fantasyland_table() const { return fantasyland_table_; }
+
     private:
         omp::HandEvaluator evaluator_5_card_;
+        FantasylandTable fantasyland_table_;
         std::unordered_map<int, HandRank> evaluator_3_card_lookup_;
         std::unordered_map<int, std::string> class_to_string_map_;
 
-        inline int get_3_card_key(const CardSet& cards) const {
-            if (cards.size() != 3) return -1;
-            std::vector<int> ranks = {get_rank(cards[0]), get_rank(cards[1]), get_rank(cards[2])};
+        inline int get_3_card_key(const Card* cards) const {
+            std::array<int, 3> ranks = {get_rank(cards[0]), get_rank(cards[1]), get_rank(cards[2])};
             std::sort(ranks.rbegin(), ranks.rend());
             return ranks[0] * 169 + ranks[1] * 13 + ranks[2];
         }
 
+        // Ранг тройки карт берем из omp (масти различны, флеша из 3 карт нет),
+        // чтобы шкала совпадала с 5-карточными рядами.
+        inline int rank_3_cards(int r0, int r1, int r2) const {
+            omp::Hand h = omp::Hand::empty();
+            h += omp::Hand(r0 * 4 + 0);
+            h += omp::Hand(r1 * 4 + 1);
+            h += omp::Hand(r2 * 4 + 2);
+            return RANK_CEIL - evaluator_5_card_.evaluate(h);
+        }
+
         inline void init_3_card_lookup() {
             // Инициализация для троек
             for (int r = 0; r <= 12; ++r) {
-                evaluator_3_card_lookup_[r*169 + r*13 + r] = {13 - r, 6, "Trips"};
+                evaluator_3_card_lookup_[r*169 + r*13 + r] = {rank_3_cards(r, r, r), 6, "Trips"};
             }
-            int rank_val = 14;
             // Инициализация для пар
             for (int p = 12; p >= 0; --p) {
                 for (int k = 12; k >= 0; --k) {
                     if (p == k) continue;
                     std::vector<int> ranks = {p, p, k};
                     std::sort(ranks.rbegin(), ranks.rend());
-                    evaluator_3_card_lookup_[ranks[0]*169+ranks[1]*13+ranks[2]] = {rank_val++, 8, "Pair"};
+                    evaluator_3_card_lookup_[ranks[0]*169+ranks[1]*13+ranks[2]] = {rank_3_cards(p, p, k), 8, "Pair"};
                 }
             }
             // Инициализация для старшей карты
             for (int r1 = 12; r1 >= 2; --r1) {
                 for (int r2 = r1 - 1; r2 >= 1; --r2) {
                     for (int r3 = r2 - 1; r3 >= 0; --r3) {
-                        evaluator_3_card_lookup_[r1*169+r2*13+r3] = {rank_val++, 9, "High Card"};
+                        evaluator_3_card_lookup_[r1*169+r2*13+r3] = {rank_3_cards(r1, r2, r3), 9, "High Card"};
                     }
                 }
             }
@@ -3,19 +3,22 @@
 #pragma once
 #include "game_state.hpp"
 #include <string>
-#include <sstream>
+#include <array>
 #include <algorithm>
 
 namespace ofc {
 
-    inline std::string get_row_summary(const CardSet& cards) {
-        if (cards.empty()) return "E";
+    // УЛУЧШЕНО: сводки и ключ дописываются в строку вызывающего без stringstream и промежуточных
+    // векторов — обход собирает ключ в строке из арены потока (формат ключа прежний).
+    template <typename String>
+    inline void append_row_summary(const Card* cards, size_t count, String& out) {
+        if (count == 0) { out += 'E'; return; }
 
         int flush_suit = -1;
-        if (cards.size() > 1) {
+        if (count > 1) {
             bool is_flush_draw = true;
             int first_suit = get_suit(cards[0]);
-            for (size_t i = 1; i < cards.size(); ++i) {
+            for (size_t i = 1; i < count; ++i) {
                 if (get_suit(cards[i]) != first_suit) {
                     is_flush_draw = false;
                     break;
@@ -24,58 +27,70 @@ namespace ofc {
             if (is_flush_draw) flush_suit = first_suit;
         }
 
-        std::vector<int> ranks;
-        for(Card c : cards) ranks.push_back(get_rank(c));
-        std::sort(ranks.begin(), ranks.end());
+        std::array<int, 13> rank_counts{};
+        for (size_t i = 0; i < count; ++i) rank_counts[get_rank(cards[i])]++;
 
         int pairs = 0, trips = 0;
-        for (size_t i = 0; i < ranks.size(); ) {
-            size_t j = i;
-            while (j < ranks.size() && ranks[j] == ranks[i]) j++;
-            if (j - i == 2) pairs++;
-            if (j - i == 3) trips++;
-            i = j;
+        for (int n : rank_counts) {
+            if (n == 2) pairs++;
+            if (n == 3) trips++;
         }
 
-        std::stringstream ss;
-        ss << "C" << cards.size();
-        if (trips > 0) ss << "T" << trips;
-        if (pairs > 0) ss << "P" << pairs;
-        if (flush_suit != -1) ss << "F" << flush_suit;
-        
-        return ss.str();
+        out += 'C';
+        out += char('0' + count);
+        if (trips > 0) { out += 'T'; out += char('0' + trips); }
+        if (pairs > 0) { out += 'P'; out += char('0' + pairs); }
+        if (flush_suit != -1) { out += 'F'; out += char('0' + flush_suit); }
     }
 
-    inline std::string get_infoset_key(const GameState& state) {
-        std::stringstream ss;
+    template <size_t N, typename String>
+    inline void append_row_summary(const std::array<Card, N>& row, String& out) {
+        std::array<Card, N> cards;
+        size_t count = 0;
+        for (Card c : row) if (c != INVALID_CARD) cards[count++] = c;
+        append_row_summary(cards.data(), count, out);
+    }
+
+    inline std::string get_row_summary(const CardSet& cards) {
+        std::string out;
+        append_row_summary(cards.data(), cards.size(), out);
+        return out;
+    }
+
+    template <typename String>
+    inline void append_infoset_key(const GameState& state, String& out) {
+        static const char RANKS[] = "23456789TJQKA";
+        static const char SUITS[] = "shdc";
         int player = state.get_current_player();
         const Board& my_board = state.get_player_board(player);
         const Board& opp_board = state.get_opponent_board(player);
 
-        // УЛУЧШЕНО: Используем новый API для get_row_cards, чтобы избежать лишних аллокаций
-        CardSet my_bot_cards, my_mid_cards, my_top_cards;
-        my_board.get_row_cards("bottom", my_bot_cards);
-        my_board.get_row_cards("middle", my_mid_cards);
-        my_board.get_row_cards("top", my_top_cards);
-
-        CardSet opp_bot_cards, opp_mid_cards, opp_top_cards;
-        opp_board.get_row_cards("bottom", opp_bot_cards);
-        opp_board.get_row_cards("middle", opp_mid_cards);
-        opp_board.get_row_cards("top", opp_top_cards);
+        out += 'S';
+        out += char('0' + state.get_street());
+        out += "|B:";  append_row_summary(my_board.bottom, out);
+        out += ";M:";  append_row_summary(my_board.middle, out);
+        out += ";T:";  append_row_summary(my_board.top, out);
+        out += "|OB:"; append_row_summary(opp_board.bottom, out);
+        out += ";OM:"; append_row_summary(opp_board.middle, out);
+        out += ";OT:"; append_row_summary(opp_board.top, out);
+        out += "|H:";
 
-        ss << "S" << state.get_street() << "|";
-        ss << "B:" << get_row_summary(my_bot_cards) << ";";
-        ss << "M:" << get_row_summary(my_mid_cards) << ";";
-        ss << "T:" << get_row_summary(my_top_cards) << "|";
-        ss << "OB:" << get_row_summary(opp_bot_cards) << ";";
-        ss << "OM:" << get_row_summary(opp_mid_cards) << ";";
-        ss << "OT:" << get_row_summary(opp_top_cards) << "|";
+        std::array<Card, 5> hand;
+        const auto& dealt = state.get_dealt_cards();
+        size_t n = std::min(dealt.size(), hand.size());
+        std::copy(dealt.begin(), dealt.begin() + n, hand.begin());
+        std::sort(hand.begin(), hand.begin() + n);
+        for (size_t i = 0; i < n; ++i) {
+            if (hand[i] == INVALID_CARD) { out += "??"; continue; }
+            out += RANKS[get_rank(hand[i])];
+            out += SUITS[get_suit(hand[i])];
+        }
+    }
 
-        CardSet hand = state.get_dealt_cards();
-        std::sort(hand.begin(), hand.end());
-        ss << "H:";
-        for(Card c : hand) ss << card_to_string(c);
-        
-        return ss.str();
+    inline std::string get_infoset_key(const GameState& state) {
+        std::string key;
+        key.reserve(64);
+        append_infoset_key(state, key);
+        return key;
     }
 }
@@ -0,0 +1,137 @@
+// mccfr_ofc-main/cpp_src/leaf_estimator.hpp
+
+#pragma once
+#include "game_state.hpp"
+#include "infoset.hpp"
+#include <omp/Random.h>
+#include <vector>
+#include <memory>
+#include <unordered_map>
+#include <fstream>
+#include <functional>
+#include <atomic>
+
+namespace ofc {
+
+    // Генератор на поток: у каждого потока свое зерно из общего счетчика.
+    inline omp::XoroShiro128Plus& thread_rng() {
+        static std::atomic<uint64_t> seed_counter{0x9E3779B97F4A7C15ull};
+        thread_local omp::XoroShiro128Plus rng(seed_counter.fetch_add(0x9E3779B97F4A7C15ull));
+        return rng;
+    }
+
+    // Оценка листьев при обходе с ограничением глубины. Вызывается пакетами (все листья узла сразу),
+    // чтобы реализации могли векторизовать работу. Возвращает ценность для игрока 0 (игра с нулевой суммой).
+    // Реализации должны быть потокобезопасны: их вызывают одновременно из всех потоков обучения.
+    class LeafEstimator {
+    public:
+        virtual ~LeafEstimator() = default;
+        virtual void estimate(const std::vector<const GameState*>& states, std::vector<double>& out_values) const = 0;
+    };
+
+    // Эвристика: роялти уже собранных рядов и штраф за фол по оценке вероятности фола.
+    class HeuristicLeafEstimator : public LeafEstimator {
+    public:
+        HeuristicLeafEstimator(const HandEvaluator& evaluator, int foul_samples = 32)
+            : evaluator_(evaluator), foul_samples_(foul_samples) {}
+
+        void estimate(const std::vector<const GameState*>& states, std::vector<double>& out_values) const override {
+            omp::XoroShiro128Plus& rng = thread_rng();
+            out_values.resize(states.size());
+            for (size_t i = 0; i < states.size(); ++i) out_values[i] = estimate_one(*states[i], rng);
+        }
+
+        inline double estimate_one(const GameState& state, omp::XoroShiro128Plus& rng) const {
+            const int SCOOP_BONUS = 3;
+            double r1 = partial_royalty(state.get_player_board(0));
+            double r2 = partial_royalty(state.get_player_board(1));
+            double f1 = state.estimate_foul_probability(0, evaluator_, rng, foul_samples_);
+            double f2 = state.estimate_foul_probability(1, evaluator_, rng, foul_samples_);
+            return (1.0 - f1) * (1.0 - f2) * (r1 - r2)
+                 + f2 * (1.0 - f1) * (SCOOP_BONUS + r1)
+                 - f1 * (1.0 - f2) * (SCOOP_BONUS + r2);
+        }
+
+    private:
+        // Роялти рядов по уже выложенным картам: трипс в середине, пара/трипс наверху и т.п.
+        inline double partial_royalty(const Board& board) const {
+            omp::Hand mid = omp::Hand::empty(), bot = omp::Hand::empty();
+            for (Card c : board.middle) if (c != INVALID_CARD) mid += omp::Hand(c);
+            for (Card c : board.bottom) if (c != INVALID_CARD) bot += omp::Hand(c);
+            int royalty = evaluator_.get_royalty_by_strength(evaluator_.strength(mid), true) +
+                          evaluator_.get_royalty_by_strength(evaluator_.strength(bot), false);
+
+            std::array<Card, 3> top;
+            int n = 0;
+            for (Card c : board.top) if (c != INVALID_CARD) top[n++] = c;
+            if (n == 3) royalty += evaluator_.get_top_royalty(top[0], top[1], top[2]);
+            else if (n == 2 && get_rank(top[0]) == get_rank(top[1]) && get_rank(top[0]) >= 4) royalty += get_rank(top[0]) - 3;
+            return royalty;
+        }
+
+        const HandEvaluator& evaluator_;
+        int foul_samples_;
+    };
+
+    // Таблица ценностей листьев по хешу ключа инфосета; для отсутствующих ключей — запасная оценка.
+    // Формат файла: size_t count, затем count пар (uint64_t key_hash, float value).
+    class LookupLeafEstimator : public LeafEstimator {
+    public:
+        explicit LookupLeafEstimator(std::shared_ptr<const LeafEstimator> fallback) : fallback_(std::move(fallback)) {}
+
+        static inline uint64_t leaf_key(const GameState& state) {
+            return std::hash<std::string>{}(get_infoset_key(state));
+        }
+
+        void estimate(const std::vector<const GameState*>& states, std::vector<double>& out_values) const override {
+            out_values.resize(states.size());
+            std::vector<const GameState*> missing;
+            std::vector<size_t> missing_idx;
+            for (size_t i = 0; i < states.size(); ++i) {
+                auto it = values_.find(leaf_key(*states[i]));
+                if (it != values_.end()) out_values[i] = it->second;
+                else { missing.push_back(states[i]); missing_idx.push_back(i); }
+            }
+            if (missing.empty() || !fallback_) return;
+            std::vector<double> fallback_values;
+            fallback_->estimate(missing, fallback_values);
+            for (size_t j = 0; j < missing.size(); ++j) out_values[missing_idx[j]] = fallback_values[j];
+        }
+
+        inline void set(uint64_t key_hash, float value) { values_[key_hash] = value; }
+        inline size_t size() const { return values_.size(); }
+
+        inline void save(const std::string& path) const {
+            std::ofstream out(path, std::ios::binary);
+            if (!out) throw std::runtime_error("Cannot open file for writing: " + path);
+            size_t count = values_.size();
+            out.write(reinterpret_cast<const char*>(&count), sizeof(count));
+            for (const auto& kv : values_) {
+                out.write(reinterpret_cast<const char*>(&kv.first), sizeof(kv.first));
+                out.write(reinterpret_cast<const char*>(&kv.second), sizeof(kv.second));
+            }
+        }
+
+        inline void load(const std::string& path) {
+            std::ifstream in(path, std::ios::binary);
+            if (!in) throw std::runtime_error("Cannot open leaf value table: " + path);
+            size_t count = 0;
+            in.read(reinterpret_cast<char*>(&count), sizeof(count));
+            std::unordered_map<uint64_t, float> values;
+            values.reserve(count);
+            for (size_t i = 0; i < count; ++i) {
+                uint64_t key;
+                float value;
+                in.read(reinterpret_cast<char*>(&key), sizeof(key));
+                in.read(reinterpret_cast<char*>(&value), sizeof(value));
+                if (in.fail()) throw std::runtime_error("Truncated leaf value table: " + path);
+                values[key] = value;
+            }
+            values_ = std::move(values);
+        }
+
+    private:
+        std::unordered_map<uint64_t, float> values_;
+        std::shared_ptr<const LeafEstimator> fallback_;
+    };
+}
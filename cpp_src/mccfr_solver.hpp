@@ -1,6 +1,14 @@
 #pragma once
 #include "game_state.hpp"
 #include "infoset.hpp"
+#include "fantasyland.hpp"
+#include "leaf_estimator.hpp"
+#include "rollout.hpp"
+#include "scratch.hpp"
+#include "node_table.hpp"
+#include "thread_pool.hpp"
+#include "numa.hpp"
+#include "perf_counters.hpp"
 #include <string>
 #include <vector>
 #include <unordered_map>
@@ -9,176 +17,1679 @@
 #include <iostream>
 #include <fstream>
 #include <algorithm>
+#include <memory>
+#include <memory_resource>
+#include <string_view>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <cmath>
+#include <limits>
 #include <omp.h>
 
 namespace ofc {
 
-    struct Node {
-        std::vector<double> regret_sum;
-        std::vector<double> strategy_sum;
-        int num_actions = 0;
+    // Кадр узла в обходе с чередованием (SolverConfig::interleave_traversals): локальные данные
+    // рекурсивного mccfr_traverse, которые переживают переключение потока на другой обход.
+    struct LaneFrame {
+        GameState state;
+        ActionList legal_actions;
+        std::pmr::string infoset_key;
+        uint64_t key_hash = 0;
+        // false — узел еще не прочитан: обход ждет, пока prefetch подтянет ячейку индекса.
+        bool loaded = false;
+        // nullptr после чтения — узел еще не создан (SolverConfig::materialize_visits).
+        Node* node = nullptr;
+        HotNodeCache::Entry* hot = nullptr;
+        double* strategy = nullptr;
+        double* action_utils = nullptr;
+        double p1_reach;
+        double p2_reach;
+        int depth;
+        // Потомок, который сейчас обходится (или следующий).
+        int next_action = 0;
+        ScratchStack::Mark child_mark{0, 0};
+
+        LaneFrame(GameState&& s, ActionList&& actions, double r1, double r2, int d, std::pmr::memory_resource* mr)
+            : state(std::move(s)), legal_actions(std::move(actions)), infoset_key(mr), p1_reach(r1), p2_reach(r2), depth(d) {}
+    };
+
+    // Один из обходов, которые поток ведет одновременно: своя арена (кадры разных обходов
+    // живут вперемешку во времени, но LIFO внутри обхода) и явный стек кадров.
+    struct TraversalLane {
+        ScratchStack stack{1 << 20};
+        std::vector<LaneFrame> frames;
+        // Игрок, за которого идет итерация обхода (SolverConfig::alternating_updates; -1 — оба).
+        int traverser = -1;
+    };
+
+    // Временные данные обхода на поток; переиспользуются между итерациями без аллокаций.
+    struct TraversalScratch {
+        // Кадры узлов: списки действий, состояния потомков, ключ, стратегия и полезности.
+        ScratchStack stack;
+        // Журнал обновлений потока; сливается в таблицу узлов по порогу update_flush_threshold.
+        UpdateLog updates;
+        // Приращения узлов верхних уровней (SolverConfig::hot_depth) и итерации с последнего сброса в журнал.
+        HotNodeCache hot;
+        int hot_iterations = 0;
+        std::vector<GameState> leaf_states;
+        std::vector<int> leaf_actions;
+        std::vector<const GameState*> leaf_batch;
+        std::vector<double> leaf_values;
+        // Позиция стека перед первым отложенным листом: память листьев возвращается после оценки.
+        ScratchStack::Mark leaf_mark{0, 0};
+        // Сколько ячеек таблицы запрошено заранее для потомков (SolverConfig::prefetch_distance).
+        long long child_prefetches = 0;
+        // Ребра к потомкам: обойденные и отсеченные по сожалениям (SolverConfig::regret_pruning).
+        long long traversed_edges = 0;
+        long long pruned_edges = 0;
+        // Приращения узла в режиме SolverConfig::hogwild: прибавляются к узлу сразу, мимо журнала.
+        std::vector<double> deltas;
+        std::vector<std::unique_ptr<TraversalLane>> lanes;
+        std::vector<TraversalLane*> active_lanes;
+
+        inline long long refills() const {
+            long long total = stack.block_allocations() + updates.growths();
+            for (const auto& lane : lanes) total += lane->stack.block_allocations();
+            return total;
+        }
     };
 
-    struct Update {
-        std::string infoset_key;
-        int num_actions;
-        std::vector<double> regret_update;
-        std::vector<double> strategy_update;
+    enum LeafEstimatorKind {
+        LEAF_HEURISTIC = 0,
+        LEAF_LOOKUP = 1,
+        LEAF_ROLLOUT = 2
+    };
+
+    enum ParallelBackend {
+        PARALLEL_OPENMP = 0,
+        PARALLEL_THREAD_POOL = 1
+    };
+
+    // Расписание накопления. Дисконтирование — в конце каждого интервала из discount_interval итераций
+    // (как Linear CFR в Pluribus): T — номер закончившегося интервала. Таблица при этом не проходится:
+    // узлы хранят эпоху и догоняют множители при следующем обращении (NodeTable::discount), так что
+    // короткий интервал стоит только 4 байт эпохи на узел.
+    enum UpdateSchedule {
+        SCHEDULE_VANILLA = 0,   // сожаления и веса стратегии копятся без изменений
+        SCHEDULE_LINEAR = 1,    // Linear CFR: все накопленное умножается на T / (T + 1)
+        SCHEDULE_DCFR = 2,      // DCFR: сожаления > 0 на T^a / (T^a + 1), < 0 на T^b / (T^b + 1), стратегия на (T / (T + 1))^g
+        SCHEDULE_CFR_PLUS = 3   // CFR+: сожаления не ниже нуля, стратегия усредняется линейно (T / (T + 1))
+    };
+
+    // Правило построения стратегии по сожалениям.
+    enum RegretMatchingRule {
+        RM_STANDARD = 0,        // пропорционально положительным накопленным сожалениям
+        RM_PREDICTIVE = 1       // Predictive CFR+: к сожалениям прибавляется последнее мгновенное (прогноз узла)
+    };
+
+    struct SolverConfig {
+        // Ограничение глубины: узлы после улицы max_street оцениваются LeafEstimator (0 — без ограничения).
+        int max_street = 0;
+        int leaf_estimator = LEAF_HEURISTIC;
+        // Сколько листьев узла передавать оценщику за один вызов.
+        int leaf_batch_size = 256;
+        // Параметры LEAF_ROLLOUT: границы числа доигрываний и цель по стандартной ошибке.
+        int rollout_min = 32;
+        int rollout_max = 1024;
+        double rollout_std_error = 0.5;
+        // Журнал обновлений потока сливается в таблицу узлов, когда в нем набирается столько
+        // значений (0 — после каждой итерации). В любом случае остаток сливается в конце train.
+        int update_flush_threshold = 1 << 20;
+        // Параллелизм внутри итерации: потомки узлов на глубине меньше task_depth обходятся
+        // задачами, которые забирают простаивающие потоки (0 — без задач; включается явно,
+        // обычно 2). Узлы с числом действий меньше task_min_actions обходятся последовательно —
+        // задача там дороже работы.
+        int task_depth = 0;
+        int task_min_actions = 8;
+        // PARALLEL_THREAD_POOL — собственный пул решателя вместо OpenMP (например, в процессе Python
+        // с другими библиотеками на OpenMP/BLAS). num_threads: 0 — по умолчанию рантайма/все ядра.
+        // pin_threads закрепляет потоки пула за ядрами.
+        int parallel_backend = PARALLEL_OPENMP;
+        int num_threads = 0;
+        int pin_threads = 0;
+        // Размещение таблицы узлов по сокетам (NumaMode); только для PARALLEL_THREAD_POOL,
+        // потоки которого распределяются по узлам NUMA. NUMA_LOCAL закрепляет потоки за ядрами
+        // их узлов независимо от pin_threads: иначе планировщик уводит поток с узла его шарда.
+        int numa_mode = NUMA_OFF;
+        // Сколько обходов train поток ведет одновременно, переключаясь между ними на чтениях
+        // таблицы узлов, пока идет prefetch (0 — обычный рекурсивный обход). Обходы с
+        // чередованием не порождают задач поддеревьев (task_depth не действует).
+        int interleave_traversals = 0;
+        // Рекурсивный обход: состояния и ключи всех потомков узла строятся заранее, перед спуском
+        // в потомка i ячейка потомка i + prefetch_distance запрашивается в кэш, а потомок берет
+        // готовый ключ вместо повторного построения (0 — без упреждения).
+        int prefetch_distance = 0;
+        // Точность накопителей узлов (NodeStorage); для STORAGE_INT32 сожаления хранятся
+        // в единицах 1/regret_scale и не ниже regret_floor.
+        int storage = STORAGE_DOUBLE;
+        double regret_scale = 1000.0;
+        double regret_floor = -1e6;
+        // Узлы шире sparse_top_k действий хранят накопители только для sparse_top_k лучших
+        // действий и общий пол для остальных (см. NodeEncoding::top_k; 0 — все узлы плотные).
+        int sparse_top_k = 0;
+        // Слябы таблицы узлов на прозрачных больших страницах (2 МБ) — меньше промахов TLB.
+        int huge_pages = 0;
+        // Узлы на глубине меньше hot_depth поток читает из своего снимка и копит по ним приращения
+        // локально, сбрасывая их в журнал раз в hot_reduce_interval своих итераций и в конце train
+        // (0 — все узлы напрямую через таблицу).
+        int hot_depth = 0;
+        int hot_reduce_interval = 64;
+        // Узел таблицы создается на materialize_visits-м посещении, до того за него хранится только
+        // счетчик, стратегия равномерна, а обновления отбрасываются (1 — при первом посещении).
+        int materialize_visits = 1;
+        // Отсечение по сожалениям: после prune_warmup итераций решателя действия с сожалением ниже
+        // prune_threshold не обходятся — их вероятность нулевая, так что ценность узла от них
+        // не зависит, а их сожаления в этом посещении не обновляются. Отсекается только в узлах,
+        // где есть действие с положительным сожалением; с вероятностью prune_explore узел
+        // обходится целиком, чтобы отсеченные действия могли вернуться.
+        int regret_pruning = 0;
+        double prune_threshold = -300.0;
+        int prune_warmup = 1000;
+        double prune_explore = 0.05;
+        // Расписание накопления (UpdateSchedule) и параметры DCFR. Веса стратегии не копятся,
+        // пока решатель не выполнил averaging_delay итераций (ранняя игра почти случайна).
+        int schedule = SCHEDULE_VANILLA;
+        int discount_interval = 100;
+        double dcfr_alpha = 1.5;
+        double dcfr_beta = 0.0;
+        double dcfr_gamma = 2.0;
+        int averaging_delay = 0;
+        // RegretMatchingRule; RM_PREDICTIVE хранит в узле прогноз (см. NodeEncoding::predictive)
+        // и обычно сочетается с SCHEDULE_CFR_PLUS. Прогноз — сумма приращений узла за одно слияние,
+        // поэтому при RM_PREDICTIVE журнал и горячие узлы сливаются после каждой итерации потока
+        // (update_flush_threshold и hot_reduce_interval не действуют, см. end_iteration): прогноз —
+        // мгновенное сожаление последней итерации, задевшей узел, при любом числе потоков.
+        // Чередование обходов и задачи поддеревьев смешали бы в одном слиянии части разных
+        // итераций, а hogwild прибавляет каждое посещение отдельно, поэтому с ними RM_PREDICTIVE
+        // не сочетается.
+        int regret_matching = RM_STANDARD;
+        // Pure CFR: в каждом узле, кроме узлов игрока, за которого идет итерация (игроки чередуются
+        // по итерациям), обходится одно чистое действие, выбранное по сожалениям. Досягаемости
+        // не перемножаются: сожаление — разность ценностей действий, вес стратегии — число выборов.
+        // Требует STORAGE_INT32. Обход рекурсивный, в одном потоке на итерацию, поэтому
+        // interleave_traversals, task_depth и prefetch_distance должны быть 0; отсечения
+        // (regret_pruning) и alternating_updates (игроки и так чередуются) в нем нет — set_config
+        // отвергает эти настройки. Оценщик листьев и max_street действуют как обычно.
+        int pure_cfr = 0;
+        // Hogwild: приращения прибавляются к накопителям узла сразу, без журнала и без блокировки
+        // шарда; одновременные прибавления разных потоков к одному узлу могут теряться. Блокировка
+        // остается только на поиске и создании узла в индексе. Горячие узлы (hot_depth) копятся
+        // как обычно. Только для плотных узлов (sparse_top_k = 0): разреженный узел при вытеснении
+        // переписывает свои индексы действий.
+        int hogwild = 0;
+        // VR-MCCFR для Pure CFR: узлы хранят базовые значения действий (NodeEncoding::baselines),
+        // и ценность узла с выбранным действием s оценивается как sum_a sigma(a) b(a) + u(s) - b(s)
+        // (контрольная переменная: то же матожидание, меньше дисперсия, когда b близко к u).
+        // После спуска b(s) сдвигается к u(s) с шагом baseline_alpha. Базовые значения читаются
+        // и обновляются в узле без блокировки, поэтому режим только для одного потока обучения
+        // (num_threads, разрешенный для бэкенда, равен 1). Используются только в pure_traverse:
+        // обход внешней выборки (mccfr_traverse) раскрывает все действия и их не читает.
+        int vr_baselines = 0;
+        double baseline_alpha = 0.1;
+        // Поочередные обновления: итерация идет за одного игрока (по очереди по номеру итерации)
+        // и пишет сожаления только в его узлах, а веса стратегии — только в узлах соперника.
+        // Записи журнала вдвое короче. Обход по-прежнему раскрывает все действия обоих игроков.
+        int alternating_updates = 0;
+        // Веса стратегии узла выделяются отдельным блоком при первом ненулевом весе (см.
+        // NodeEncoding::lazy_strategies): окупается, когда стратегия копится не во всех узлах —
+        // Pure CFR, alternating_updates, averaging_delay. В обычном обходе веса получает каждый
+        // узел, и флаг только добавляет 8 байт указателя на узел. Несовместим с hogwild (блок
+        // выделяется под блокировкой шарда), RM_PREDICTIVE и vr_baselines.
+        int lazy_strategy_sums = 0;
     };
 
     class MCCFRSolver {
     public:
-        MCCFRSolver() {}
+        MCCFRSolver() { reset_leaf_estimator(); }
 
-        inline void train(int iterations) {
-            #pragma omp parallel for
-            for (int i = 0; i < iterations; ++i) {
-                thread_local std::vector<Update> local_updates;
-                local_updates.clear();
+        // Таблица ценности фантазии загружается один раз при старте и дальше индексируется в get_payoffs.
+        explicit MCCFRSolver(const std::string& fantasyland_table_path) {
+            if (!fantasyland_table_path.empty()) load_fantasyland_table(fantasyland_table_path);
+            reset_leaf_estimator();
+        }
+
+        inline const SolverConfig& get_config() const { return config_; }
 
-                GameState initial_state;
-                mccfr_traverse(initial_state, 1.0, 1.0, local_updates);
+        inline size_t get_node_count() const { return nodes_.size(); }
 
-                apply_updates(local_updates);
+        // Узлы, посещенные меньше materialize_visits раз: у них пока только счетчик в индексе.
+        inline size_t get_node_counter_count() const { return nodes_.counter_count(); }
+
+        inline void set_config(const SolverConfig& config) {
+            if (config.max_street < 0 || config.max_street > 5) throw std::invalid_argument("max_street must be 0..5");
+            if (config.leaf_batch_size <= 0) throw std::invalid_argument("leaf_batch_size must be positive");
+            if (config.rollout_min < 1 || config.rollout_max < config.rollout_min) throw std::invalid_argument("Need 1 <= rollout_min <= rollout_max");
+            if (config.update_flush_threshold < 0) throw std::invalid_argument("update_flush_threshold must be non-negative");
+            if (config.task_depth < 0 || config.task_min_actions < 1) throw std::invalid_argument("Need task_depth >= 0 and task_min_actions >= 1");
+            if (config.parallel_backend != PARALLEL_OPENMP && config.parallel_backend != PARALLEL_THREAD_POOL) throw std::invalid_argument("Unknown parallel backend");
+            if (config.num_threads < 0) throw std::invalid_argument("num_threads must be non-negative");
+            if (config.numa_mode < NUMA_OFF || config.numa_mode > NUMA_INTERLEAVE) throw std::invalid_argument("Unknown NUMA mode");
+            if (config.interleave_traversals < 0 || config.interleave_traversals > 64) throw std::invalid_argument("interleave_traversals must be 0..64");
+            if (config.prefetch_distance < 0) throw std::invalid_argument("prefetch_distance must be non-negative");
+            if (config.hot_depth < 0 || config.hot_reduce_interval < 1) throw std::invalid_argument("Need hot_depth >= 0 and hot_reduce_interval >= 1");
+            if (config.materialize_visits < 1) throw std::invalid_argument("materialize_visits must be positive");
+            if (config.schedule < SCHEDULE_VANILLA || config.schedule > SCHEDULE_CFR_PLUS) throw std::invalid_argument("Unknown update schedule");
+            if (config.regret_matching != RM_STANDARD && config.regret_matching != RM_PREDICTIVE) throw std::invalid_argument("Unknown regret matching rule");
+            if (config.regret_matching == RM_PREDICTIVE && (config.interleave_traversals > 0 || config.task_depth > 0 || config.hogwild)) {
+                throw std::invalid_argument("Predictive regret matching needs whole-iteration merges (interleave_traversals = 0, task_depth = 0, no hogwild)");
+            }
+            if (config.discount_interval < 1 || config.averaging_delay < 0) throw std::invalid_argument("Need discount_interval >= 1 and averaging_delay >= 0");
+            if (!(config.dcfr_alpha >= 0) || !(config.dcfr_beta >= 0) || !(config.dcfr_gamma >= 0)) throw std::invalid_argument("DCFR exponents must be non-negative");
+            if (!(config.prune_threshold < 0) || config.prune_warmup < 0 || !(config.prune_explore >= 0 && config.prune_explore <= 1)) {
+                throw std::invalid_argument("Need prune_threshold < 0, prune_warmup >= 0 and prune_explore in [0, 1]");
             }
+            if (config.storage < STORAGE_DOUBLE || config.storage > STORAGE_INT32) throw std::invalid_argument("Unknown node storage");
+            if (config.sparse_top_k < 0) throw std::invalid_argument("sparse_top_k must be non-negative");
+            if (config.hogwild && config.sparse_top_k > 0) throw std::invalid_argument("Hogwild updates require dense nodes (sparse_top_k = 0)");
+            if (config.lazy_strategy_sums && (config.hogwild || config.regret_matching == RM_PREDICTIVE || config.vr_baselines)) {
+                throw std::invalid_argument("lazy_strategy_sums is incompatible with hogwild, predictive regret matching and VR baselines");
+            }
+            if (config.vr_baselines && !config.pure_cfr) throw std::invalid_argument("VR baselines require pure_cfr (the only mode that samples actions)");
+            if (config.vr_baselines && num_threads_of(config) > 1) throw std::invalid_argument("VR baselines are updated without locks and need num_threads = 1");
+            if (!(config.baseline_alpha > 0 && config.baseline_alpha <= 1)) throw std::invalid_argument("baseline_alpha must be in (0, 1]");
+            if (config.pure_cfr && config.storage != STORAGE_INT32) throw std::invalid_argument("Pure CFR requires int32 node storage");
+            if (config.pure_cfr && (config.interleave_traversals > 0 || config.task_depth > 0 || config.prefetch_distance > 0 ||
+                                    config.regret_pruning || config.alternating_updates)) {
+                throw std::invalid_argument("Pure CFR does not use interleave_traversals, task_depth, prefetch_distance, "
+                                            "regret_pruning or alternating_updates; set them to 0");
+            }
+            if (!(config.regret_scale > 0) || config.regret_floor > 0 ||
+                config.regret_floor * config.regret_scale < (double)std::numeric_limits<int32_t>::min()) {
+                throw std::invalid_argument("Need regret_scale > 0 and int32 range for regret_floor * regret_scale <= 0");
+            }
+            if (config.numa_mode != NUMA_OFF && config.parallel_backend != PARALLEL_THREAD_POOL) {
+                throw std::invalid_argument("NUMA placement requires the thread pool backend");
+            }
+            // Пул пересоздается при смене размера, закрепления или размещения; иначе потоки живут между вызовами train.
+            if (config.parallel_backend != PARALLEL_THREAD_POOL || config.num_threads != config_.num_threads ||
+                config.pin_threads != config_.pin_threads || config.numa_mode != config_.numa_mode) {
+                pool_.reset();
+            }
+            if (config.numa_mode != config_.numa_mode || config.huge_pages != config_.huge_pages) {
+                if (numa_topology_.node_ids.empty()) numa_topology_ = NumaTopology::detect();
+                nodes_.configure_memory(static_cast<NumaMode>(config.numa_mode), numa_topology_, config.huge_pages != 0);
+            }
+            if (encoding_of(config) != encoding_of(config_)) nodes_.configure_encoding(encoding_of(config));
+            if (config.materialize_visits != config_.materialize_visits) nodes_.configure_materialization(config.materialize_visits);
+            bool estimator_changed = config.leaf_estimator != config_.leaf_estimator || config.rollout_min != config_.rollout_min ||
+                                     config.rollout_max != config_.rollout_max || config.rollout_std_error != config_.rollout_std_error;
+            config_ = config;
+            if (estimator_changed) reset_leaf_estimator();
+        }
+
+        // Подключение собственного оценщика листьев (например, из C++-кода поверх решателя).
+        inline void set_leaf_estimator(std::shared_ptr<const LeafEstimator> estimator) {
+            if (!estimator) throw std::invalid_argument("Leaf estimator must not be null");
+            leaf_estimator_ = std::move(estimator);
+        }
+
+        // Таблица ценностей листьев; переключает оценщик на LEAF_LOOKUP с эвристикой для пропусков.
+        inline void load_leaf_table(const std::string& path) {
+            auto table = std::make_shared<LookupLeafEstimator>(std::make_shared<HeuristicLeafEstimator>(evaluator_));
+            table->load(path);
+            config_.leaf_estimator = LEAF_LOOKUP;
+            leaf_estimator_ = table;
         }
 
+        inline void train(int iterations) { run_iterations(iterations, nullptr); }
+
+        // По одной итерации из каждой позиции; позиции распределяются по потокам, как итерации train.
+        inline void train_positions(const std::vector<GameState>& roots) { run_iterations((int)roots.size(), roots.data()); }
+
+        // Одна итерация из заданной позиции (бенчмарки и отладка); возвращает ценность для игрока 0.
+        // Остальные потоки команды ждут на барьере single и выполняют задачи поддеревьев.
+        inline double train_from(const GameState& root) {
+            double util = 0.0;
+            if (config_.parallel_backend == PARALLEL_THREAD_POOL) {
+                thread_pool().run_on_all([&](int worker) {
+                    if (worker == 0) util = run_iteration(&root);
+                });
+                merge_pool_logs();
+                discount_if_due();
+                return util;
+            }
+
+            #pragma omp parallel num_threads(get_num_threads())
+            {
+                #pragma omp single
+                util = run_iteration(&root);
+                finish_thread();
+            }
+            discount_if_due();
+            return util;
+        }
+
+        // Число потоков обучения для текущего бэкенда.
+        inline int get_num_threads() const { return num_threads_of(config_); }
+
+        // Сколько раз арены обхода брали новый блок, а журналы обновлений расширяли буферы
+        // (суммарно по потокам); после прогрева не растет. Остальная память из кучи — таблица узлов,
+        // кэш горячих узлов, длинные ключи — здесь не учитывается.
+        inline long long get_arena_refills() const { return arena_refills_.load(); }
+
+        // Сколько ячеек таблицы узлов запрошено заранее для потомков (суммарно по потокам).
+        inline long long get_child_prefetches() const { return child_prefetches_.load(); }
+
+        // Итерации, выполненные решателем (по ним отсчитываются prune_warmup, averaging_delay
+        // и интервалы дисконтирования); сохраняется вместе со стратегией.
+        inline long long get_iteration_count() const { return iterations_.load(); }
+
+        // Ребра к потомкам, обойденные и отсеченные по сожалениям (суммарно по потокам, на конец train).
+        inline long long get_traversed_edges() const { return traversed_edges_.load(); }
+        inline long long get_pruned_edges() const { return pruned_edges_.load(); }
+
+        // Средний по узлам наибольший положительный накопленный регрет на итерацию решателя.
+        // Сумма таких регретов на итерацию ограничивает эксплуатируемость средней стратегии,
+        // поэтому величина годится как мера сходимости при сравнении режимов обучения.
+        inline double get_mean_regret() const {
+            const long long t = iterations_.load();
+            if (t == 0 || nodes_.size() == 0) return 0.0;
+            const NodeEncoding& encoding = nodes_.encoding();
+            std::vector<double> regrets;
+            double total = 0.0;
+            nodes_.for_each([&](std::string_view, const Node& node) {
+                regrets.resize(node.num_actions);
+                encoding.regrets(node.bytes(), node.num_actions, regrets.data());
+                total += std::max(0.0, *std::max_element(regrets.begin(), regrets.end()));
+            });
+            return total / nodes_.size() / t;
+        }
+
+        // Сколько кусков таблицы узлов не удалось привязать к узлам NUMA (см. SolverConfig::numa_mode).
+        inline int get_numa_bind_failures() const { return nodes_.numa_bind_failures(); }
+
+        // Память таблицы узлов: занято записями и индексом / взято у системы (байт).
+        inline size_t get_table_used_bytes() const { return nodes_.used_bytes(); }
+        inline size_t get_table_mapped_bytes() const { return nodes_.mapped_bytes(); }
+
+        // Ценность фантазии по числу карт (14-17), например из FantasylandSolver.
+        inline void set_fantasyland_bonus(int card_count, float value) {
+            evaluator_.set_fantasyland_bonus(card_count, value);
+        }
+
+        inline void load_fantasyland_table(const std::string& path) {
+            evaluator_.load_fantasyland_table(path);
+        }
+
+        // Формат файла: сигнатура, версия и кодировка накопителей, затем узлы (ключ, число действий,
+        // накопители в этой кодировке). Файлы без сигнатуры — прежний формат с double.
         inline void save_strategy(const std::string& path) const {
-            std::lock_guard<std::mutex> lock(map_mutex_);
             std::ofstream out(path, std::ios::binary);
             if (!out) throw std::runtime_error("Cannot open file for writing: " + path);
 
+            const NodeEncoding& encoding = nodes_.encoding();
+            const uint32_t version = STRATEGY_FILE_VERSION;
+            const uint32_t storage = encoding.storage;
+            const uint32_t top_k = encoding.top_k;
+            out.write(STRATEGY_FILE_MAGIC, sizeof(STRATEGY_FILE_MAGIC));
+            out.write(reinterpret_cast<const char*>(&version), sizeof(version));
+            out.write(reinterpret_cast<const char*>(&storage), sizeof(storage));
+            out.write(reinterpret_cast<const char*>(&encoding.regret_scale), sizeof(encoding.regret_scale));
+            out.write(reinterpret_cast<const char*>(&encoding.regret_floor), sizeof(encoding.regret_floor));
+            out.write(reinterpret_cast<const char*>(&top_k), sizeof(top_k));
+            const long long iterations = iterations_.load();
+            out.write(reinterpret_cast<const char*>(&iterations), sizeof(iterations));
+            const uint32_t predictive = encoding.predictive;
+            out.write(reinterpret_cast<const char*>(&predictive), sizeof(predictive));
+            const uint32_t baselines = encoding.baselines;
+            out.write(reinterpret_cast<const char*>(&baselines), sizeof(baselines));
+
             size_t map_size = nodes_.size();
             out.write(reinterpret_cast<const char*>(&map_size), sizeof(map_size));
 
-            for (const auto& pair : nodes_) {
-                size_t key_len = pair.first.length();
+            std::vector<std::byte> record;
+
+            nodes_.for_each([&](std::string_view key, const Node& node) {
+                size_t key_len = key.length();
                 out.write(reinterpret_cast<const char*>(&key_len), sizeof(key_len));
-                out.write(pair.first.c_str(), key_len);
-                const Node& node = pair.second;
+                out.write(key.data(), key_len);
                 out.write(reinterpret_cast<const char*>(&node.num_actions), sizeof(node.num_actions));
-                out.write(reinterpret_cast<const char*>(node.regret_sum.data()), node.num_actions * sizeof(double));
-                out.write(reinterpret_cast<const char*>(node.strategy_sum.data()), node.num_actions * sizeof(double));
-            }
+                // Веса пишутся на месте и при lazy_strategies: формат файла от него не зависит.
+                record.resize(encoding.file_bytes(node.num_actions));
+                encoding.copy_inline(node.bytes(), node.num_actions, record.data());
+                out.write(reinterpret_cast<const char*>(record.data()), record.size());
+            });
         }
 
+        // Накопители из файла перекодируются в текущую кодировку решателя (SolverConfig::storage).
         inline void load_strategy(const std::string& path) {
-            std::lock_guard<std::mutex> lock(map_mutex_);
             std::ifstream in(path, std::ios::binary);
             if (!in) { std::cerr << "Strategy file not found, starting new." << std::endl; return; }
 
             nodes_.clear();
-            size_t map_size;
-            in.read(reinterpret_cast<char*>(&map_size), sizeof(map_size));
+            iterations_ = 0;
+            char magic[sizeof(STRATEGY_FILE_MAGIC)];
+            in.read(magic, sizeof(magic));
             if (in.fail()) return;
 
+            NodeEncoding file_encoding;
+            size_t map_size;
+            if (std::memcmp(magic, STRATEGY_FILE_MAGIC, sizeof(magic)) == 0) {
+                uint32_t version, storage;
+                in.read(reinterpret_cast<char*>(&version), sizeof(version));
+                in.read(reinterpret_cast<char*>(&storage), sizeof(storage));
+                if (in.fail() || version < 2 || version > STRATEGY_FILE_VERSION || storage > STORAGE_INT32) {
+                    throw std::runtime_error("Unsupported strategy file format: " + path);
+                }
+                file_encoding.storage = static_cast<NodeStorage>(storage);
+                in.read(reinterpret_cast<char*>(&file_encoding.regret_scale), sizeof(file_encoding.regret_scale));
+                in.read(reinterpret_cast<char*>(&file_encoding.regret_floor), sizeof(file_encoding.regret_floor));
+                // Версия 3 добавила разреженные узлы (top_k); в версии 2 все узлы плотные.
+                uint32_t top_k = 0;
+                if (version >= 3) in.read(reinterpret_cast<char*>(&top_k), sizeof(top_k));
+                file_encoding.top_k = (int)top_k;
+                // Версия 4 сохраняет число итераций: от него идут интервалы дисконтирования и задержка усреднения.
+                long long iterations = 0;
+                if (version >= 4) in.read(reinterpret_cast<char*>(&iterations), sizeof(iterations));
+                iterations_ = iterations;
+                // Версия 5: узлы могут хранить прогнозы (Predictive CFR+).
+                uint32_t predictive = 0;
+                if (version >= 5) in.read(reinterpret_cast<char*>(&predictive), sizeof(predictive));
+                file_encoding.predictive = predictive != 0;
+                // Версия 6: базовые значения действий (VR-MCCFR).
+                uint32_t baselines = 0;
+                if (version >= 6) in.read(reinterpret_cast<char*>(&baselines), sizeof(baselines));
+                file_encoding.baselines = baselines != 0;
+                in.read(reinterpret_cast<char*>(&map_size), sizeof(map_size));
+                if (in.fail()) return;
+            } else {
+                static_assert(sizeof(magic) == sizeof(map_size), "Legacy header is the node count");
+                std::memcpy(&map_size, magic, sizeof(map_size));
+            }
+
+            std::vector<std::byte> data;
+            std::vector<double> regrets, strategy, predictions, baselines;
             for (size_t i = 0; i < map_size; ++i) {
                 size_t key_len;
                 in.read(reinterpret_cast<char*>(&key_len), sizeof(key_len));
                 std::string key(key_len, ' ');
                 in.read(&key[0], key_len);
-                Node node;
-                in.read(reinterpret_cast<char*>(&node.num_actions), sizeof(node.num_actions));
-                node.regret_sum.resize(node.num_actions);
-                node.strategy_sum.resize(node.num_actions);
-                in.read(reinterpret_cast<char*>(node.regret_sum.data()), node.num_actions * sizeof(double));
-                in.read(reinterpret_cast<char*>(node.strategy_sum.data()), node.num_actions * sizeof(double));
-                nodes_[key] = node;
+                int num_actions;
+                in.read(reinterpret_cast<char*>(&num_actions), sizeof(num_actions));
+                if (in.fail()) break;
+                data.resize(file_encoding.node_bytes(num_actions));
+                in.read(reinterpret_cast<char*>(data.data()), data.size());
+                regrets.resize(num_actions);
+                strategy.resize(num_actions);
+                file_encoding.regrets(data.data(), num_actions, regrets.data());
+                predictions.resize(num_actions);
+                file_encoding.strategies(data.data(), num_actions, strategy.data());
+                file_encoding.predictions(data.data(), num_actions, predictions.data());
+                baselines.resize(num_actions);
+                file_encoding.action_baselines(data.data(), num_actions, baselines.data());
+                nodes_.insert(key, num_actions, regrets.data(), strategy.data(), predictions.data(), baselines.data());
             }
             std::cout << "Loaded " << nodes_.size() << " infosets from strategy file." << std::endl;
         }
 
     private:
-        inline Node get_node_copy(const std::string& infoset_key, int num_actions) {
-            std::lock_guard<std::mutex> lock(map_mutex_);
-            auto it = nodes_.find(infoset_key);
-            if (it == nodes_.end() || it->second.num_actions != num_actions) {
-                Node new_node;
-                new_node.regret_sum.assign(num_actions, 0.0);
-                new_node.strategy_sum.assign(num_actions, 0.0);
-                new_node.num_actions = num_actions;
-                nodes_[infoset_key] = new_node;
-                return new_node;
+        static constexpr char STRATEGY_FILE_MAGIC[8] = {'O', 'F', 'C', 'S', 'T', 'R', 'A', 'T'};
+        static constexpr uint32_t STRATEGY_FILE_VERSION = 6;
+
+        static inline int num_threads_of(const SolverConfig& config) {
+            if (config.num_threads > 0) return config.num_threads;
+            if (config.parallel_backend == PARALLEL_THREAD_POOL) return std::max(1u, std::thread::hardware_concurrency());
+            return omp_get_max_threads();
+        }
+
+        static inline NodeEncoding encoding_of(const SolverConfig& config) {
+            NodeEncoding encoding;
+            encoding.storage = static_cast<NodeStorage>(config.storage);
+            encoding.regret_scale = config.regret_scale;
+            encoding.regret_floor = config.regret_floor;
+            encoding.top_k = config.sparse_top_k;
+            encoding.regret_plus = config.schedule == SCHEDULE_CFR_PLUS;
+            encoding.predictive = config.regret_matching == RM_PREDICTIVE;
+            encoding.baselines = config.vr_baselines != 0;
+            encoding.lazy_strategies = config.lazy_strategy_sums != 0;
+            encoding.epochs = config.schedule != SCHEDULE_VANILLA;
+            return encoding;
+        }
+
+        inline void reset_leaf_estimator() {
+            auto heuristic = std::make_shared<HeuristicLeafEstimator>(evaluator_);
+            if (config_.leaf_estimator == LEAF_LOOKUP) leaf_estimator_ = std::make_shared<LookupLeafEstimator>(heuristic);
+            else if (config_.leaf_estimator == LEAF_HEURISTIC) leaf_estimator_ = heuristic;
+            else if (config_.leaf_estimator == LEAF_ROLLOUT) {
+                RolloutConfig rollout;
+                rollout.min_rollouts = config_.rollout_min;
+                rollout.max_rollouts = config_.rollout_max;
+                rollout.std_error_target = config_.rollout_std_error;
+                leaf_estimator_ = std::make_shared<RolloutEvaluator>(evaluator_, rollout);
+            }
+            else throw std::invalid_argument("Unknown leaf estimator");
+        }
+
+        inline bool is_depth_leaf(const GameState& state) const {
+            return config_.max_street > 0 && !state.is_terminal() && state.get_street() > config_.max_street;
+        }
+
+        inline ThreadPool& thread_pool() {
+            if (!pool_) {
+                const NumaTopology* topology = config_.numa_mode != NUMA_OFF ? &numa_topology_ : nullptr;
+                const bool pin = config_.pin_threads != 0 || config_.numa_mode == NUMA_LOCAL;
+                pool_ = std::make_unique<ThreadPool>(get_num_threads(), pin, topology);
             }
-            return it->second;
+            return *pool_;
         }
 
-        inline void apply_updates(const std::vector<Update>& updates) {
-            std::lock_guard<std::mutex> lock(map_mutex_);
-            for (const auto& update : updates) {
-                Node& node = nodes_[update.infoset_key];
-                if (node.num_actions != update.num_actions) {
-                    node.regret_sum.assign(update.num_actions, 0.0);
-                    node.strategy_sum.assign(update.num_actions, 0.0);
-                    node.num_actions = update.num_actions;
+        // Итерация i начинается из roots[i] (или из новой раздачи, если roots == nullptr). Итерации
+        // идут пачками до границ интервалов дисконтирования: проход по таблице — между пачками.
+        inline void run_iterations(int iterations, const GameState* roots) {
+            int done = 0;
+            while (done < iterations) {
+                int batch = iterations - done;
+                if (config_.schedule != SCHEDULE_VANILLA) {
+                    const long long interval = config_.discount_interval;
+                    batch = (int)std::min<long long>(batch, interval - iterations_.load() % interval);
                 }
-                for(int i=0; i<update.num_actions; ++i) {
-                    node.regret_sum[i] += update.regret_update[i];
-                    node.strategy_sum[i] += update.strategy_update[i];
+                run_batch(batch, roots ? roots + done : nullptr);
+                done += batch;
+                discount_if_due();
+            }
+        }
+
+        // Дисконтирование по расписанию, если только что закончился интервал.
+        inline void discount_if_due() {
+            const long long t = iterations_.load();
+            if (config_.schedule == SCHEDULE_VANILLA || t == 0 || t % config_.discount_interval) return;
+            const double T = (double)(t / config_.discount_interval);
+            const double linear = T / (T + 1);
+            switch (config_.schedule) {
+                case SCHEDULE_LINEAR:
+                    nodes_.discount(linear, linear, linear);
+                    break;
+                case SCHEDULE_DCFR: {
+                    const double a = std::pow(T, config_.dcfr_alpha), b = std::pow(T, config_.dcfr_beta);
+                    nodes_.discount(a / (a + 1), b / (b + 1), std::pow(linear, config_.dcfr_gamma));
+                    break;
                 }
+                default:
+                    nodes_.discount(1.0, 1.0, linear);
+                    break;
             }
         }
 
-        inline std::vector<double> mccfr_traverse(GameState state, double p1_reach, double p2_reach, std::vector<Update>& local_updates) {
-            if (state.is_terminal()) {
-                auto payoffs = state.get_payoffs(evaluator_);
-                return {payoffs.first, payoffs.second};
+        inline void run_batch(int iterations, const GameState* roots) {
+            if (config_.interleave_traversals > 0) {
+                std::atomic<int> next_iteration{0};
+                if (config_.parallel_backend == PARALLEL_THREAD_POOL) {
+                    thread_pool().run_on_all([&](int) { run_interleaved(next_iteration, iterations, roots); });
+                    merge_pool_logs();
+                    return;
+                }
+                #pragma omp parallel num_threads(get_num_threads())
+                {
+                    run_interleaved(next_iteration, iterations, roots);
+                    finish_thread();
+                }
+                return;
             }
 
-            int player = state.get_current_player();
-            auto legal_actions = state.get_legal_actions();
-            if (legal_actions.empty()) {
-                // Этого не должно происходить с новой логикой, но оставим как защиту
-                return mccfr_traverse(state.apply_action({{}, INVALID_CARD}), p1_reach, p2_reach, local_updates);
+            if (config_.parallel_backend == PARALLEL_THREAD_POOL) {
+                std::atomic<int> next_iteration{0};
+                thread_pool().run_on_all([&](int) {
+                    for (int i = next_iteration++; i < iterations; i = next_iteration++) run_iteration(roots ? &roots[i] : nullptr);
+                });
+                merge_pool_logs();
+                return;
             }
-            
-            std::string infoset_key = get_infoset_key(state);
-            int num_actions = legal_actions.size();
-            
-            Node node_copy = get_node_copy(infoset_key, num_actions);
 
-            std::vector<double> strategy(num_actions);
+            // Итерации неравны по стоимости (ранние фолы, разные раздачи), поэтому schedule(dynamic):
+            // освободившийся поток берет следующую итерацию или задачи поддеревьев других потоков.
+            #pragma omp parallel num_threads(get_num_threads())
+            {
+                #pragma omp for schedule(dynamic, 1)
+                for (int i = 0; i < iterations; ++i) {
+                    run_iteration(roots ? &roots[i] : nullptr);
+                }
+                // Остаток журнала потока сливается до выхода из train.
+                finish_thread();
+            }
+        }
+
+        // Журналы сливаются отдельным проходом: поток, закончивший свои итерации, еще выполняет
+        // чужие задачи и пишет в свой журнал, пока не закончат все. При размещении NUMA_LOCAL
+        // второй проход разбирает почтовые ящики, пополненные другими сокетами в первом.
+        inline void merge_pool_logs() {
+            thread_pool().run_on_all([&](int) { finish_thread(); });
+            if (nodes_.routes_updates()) thread_pool().run_on_all([&](int) { nodes_.drain_mailbox(current_numa_node()); });
+        }
+
+        // Приращения горячих узлов уходят в журнал, журнал — в таблицу, кэш горячих узлов очищается.
+        inline void finish_thread() {
+            TraversalScratch& scratch = thread_scratch();
+            scratch.hot.reduce(scratch.updates);
+            scratch.hot.clear();
+            scratch.hot_iterations = 0;
+            traversed_edges_ += scratch.traversed_edges;
+            pruned_edges_ += scratch.pruned_edges;
+            scratch.traversed_edges = scratch.pruned_edges = 0;
+            nodes_.merge(scratch.updates, current_numa_node());
+        }
+
+        // Конец итерации потока: по hot_reduce_interval горячие узлы сбрасываются в журнал,
+        // журнал по update_flush_threshold (или вместе со сбросом) — в таблицу. При RM_PREDICTIVE —
+        // оба после каждой итерации: слияние несет ровно одну итерацию (см. SolverConfig::regret_matching).
+        inline void end_iteration(TraversalScratch& scratch) {
+            const bool predictive = config_.regret_matching == RM_PREDICTIVE;
+            bool reduce = config_.hot_depth > 0 && (++scratch.hot_iterations >= config_.hot_reduce_interval || predictive);
+            if (reduce) {
+                scratch.hot.reduce(scratch.updates);
+                scratch.hot_iterations = 0;
+            }
+            if (reduce || predictive || scratch.updates.value_count() >= (size_t)config_.update_flush_threshold) {
+                nodes_.merge(scratch.updates, current_numa_node());
+            }
+        }
+
+        // Игрок, за которого идет итерация с номером iteration: при alternating_updates — по очереди,
+        // иначе -1 (обновления обоих игроков за один обход).
+        inline int traverser_of(long long iteration) const { return config_.alternating_updates ? (int)(iteration & 1) : -1; }
+
+        // Данные обхода общие для всех решателей потока: журнал и кэш горячих узлов сбрасываются
+        // до возврата из train/train_from, поэтому между вызовами в них нет указателей на чужие узлы.
+        static inline TraversalScratch& thread_scratch() {
+            thread_local TraversalScratch scratch;
+            return scratch;
+        }
+
+        inline double run_iteration(const GameState* root) {
+            TraversalScratch& scratch = thread_scratch();
+            scratch.stack.reset();
+            const long long refills_before = scratch.refills();
+            const long long prefetches_before = scratch.child_prefetches;
+            const long long iteration = iterations_.fetch_add(1, std::memory_order_relaxed);
+
+            double util;
+            {
+                GameState initial_state = root ? GameState(*root, &scratch.stack) : GameState(2, -1, &scratch.stack);
+                util = config_.pure_cfr ? pure_traverse(initial_state, (int)(iteration & 1), 0, scratch)
+                                        : mccfr_traverse(initial_state, 1.0, 1.0, 0, traverser_of(iteration), scratch);
+            }
+            end_iteration(scratch);
+
+            arena_refills_ += scratch.refills() - refills_before;
+            child_prefetches_ += scratch.child_prefetches - prefetches_before;
+            return util;
+        }
+
+        // Поток ведет interleave_traversals обходов сразу (AMAC — чередование цепочек обращений
+        // к памяти): дойдя до чтения узла таблицы, обход подтягивает ячейку индекса через prefetch
+        // и уступает следующему, так что промахи кэша разных обходов перекрываются. Закончивший
+        // обход сразу берет следующую итерацию.
+        inline void run_interleaved(std::atomic<int>& next_iteration, int iterations, const GameState* roots) {
+            TraversalScratch& scratch = thread_scratch();
+            const long long refills_before = scratch.refills();
+            while ((int)scratch.lanes.size() < config_.interleave_traversals) {
+                scratch.lanes.push_back(std::make_unique<TraversalLane>());
+                scratch.lanes.back()->frames.reserve(64);
+            }
+
+            auto& active = scratch.active_lanes;
+            active.clear();
+            for (int l = 0; l < config_.interleave_traversals; ++l) {
+                if (start_lane(*scratch.lanes[l], next_iteration, iterations, roots)) active.push_back(scratch.lanes[l].get());
+            }
+            while (!active.empty()) {
+                for (size_t l = 0; l < active.size();) {
+                    if (step_lane(*active[l], scratch)) { ++l; continue; }
+                    end_iteration(scratch);
+                    if (start_lane(*active[l], next_iteration, iterations, roots)) { ++l; continue; }
+                    active[l] = active.back();
+                    active.pop_back();
+                }
+            }
+            arena_refills_ += scratch.refills() - refills_before;
+        }
+
+        // Берет следующую итерацию и доводит ее обход до первого чтения таблицы; false — итерации кончились.
+        inline bool start_lane(TraversalLane& lane, std::atomic<int>& next_iteration, int iterations, const GameState* roots) {
+            for (int i = next_iteration++; i < iterations; i = next_iteration++) {
+                lane.frames.clear();
+                lane.stack.reset();
+                lane.traverser = traverser_of(iterations_.fetch_add(1, std::memory_order_relaxed));
+                GameState root = roots ? GameState(roots[i], &lane.stack) : GameState(2, -1, &lane.stack);
+                double value;
+                if (enter_node(lane, std::move(root), 1.0, 1.0, 0, value)) return true;
+            }
+            return false;
+        }
+
+        // Вход в узел: то же, что начало mccfr_traverse. true — положен кадр, ждущий чтения таблицы
+        // (ячейка уже запрошена); false — ценность узла известна сразу и записана в value.
+        inline bool enter_node(TraversalLane& lane, GameState&& state, double p1_reach, double p2_reach, int depth, double& value) {
+            std::pmr::memory_resource* arena = &lane.stack;
+            while (true) {
+                if (state.is_terminal()) {
+                    value = state.get_payoffs(evaluator_).first;
+                    return false;
+                }
+                std::pair<float, float> early_payoffs;
+                if (state.get_early_payoffs(evaluator_, early_payoffs)) {
+                    value = early_payoffs.first;
+                    return false;
+                }
+                ActionList legal_actions = state.get_legal_actions(arena);
+                if (legal_actions.empty()) {
+                    state = state.apply_action({{}, INVALID_CARD}, arena);
+                    continue;
+                }
+                if (state.is_certain_foul(state.get_current_player(), evaluator_)) {
+                    state = state.apply_action(legal_actions[thread_rng()() % legal_actions.size()], arena);
+                    continue;
+                }
+
+                lane.frames.emplace_back(std::move(state), std::move(legal_actions), p1_reach, p2_reach, depth, arena);
+                LaneFrame& frame = lane.frames.back();
+                frame.infoset_key.reserve(64);
+                append_infoset_key(frame.state, frame.infoset_key);
+                frame.key_hash = NodeTable::hash_key(frame.infoset_key);
+                frame.strategy = lane.stack.push(frame.legal_actions.size());
+                frame.action_utils = lane.stack.push(frame.legal_actions.size());
+                nodes_.prefetch(frame.key_hash);
+                return true;
+            }
+        }
+
+        // Продвигает обход до следующего узла, ждущего чтения таблицы (true), или до конца итерации (false).
+        inline bool step_lane(TraversalLane& lane, TraversalScratch& scratch) {
+            auto& frames = lane.frames;
+            std::pmr::memory_resource* arena = &lane.stack;
+            while (true) {
+                LaneFrame& frame = frames.back();
+                const int num_actions = frame.legal_actions.size();
+                const int player = frame.state.get_current_player();
+                if (!frame.loaded) {
+                    frame.loaded = true;
+                    frame.node = load_node(scratch, frame.infoset_key, frame.key_hash, num_actions, frame.depth, frame.strategy, frame.hot);
+                    prune_actions(scratch, frame.strategy, frame.action_utils, num_actions);
+                    regret_matching(frame.strategy, num_actions);
+                }
+
+                if (frame.next_action < num_actions) {
+                    const int i = frame.next_action;
+                    if (is_pruned(frame.action_utils[i])) {
+                        frame.next_action++;
+                        continue;
+                    }
+                    scratch.traversed_edges++;
+                    frame.child_mark = lane.stack.mark();
+                    GameState next_state = frame.state.apply_action(frame.legal_actions[i], arena);
+                    if (is_depth_leaf(next_state)) {
+                        defer_leaf(scratch, lane.stack, frame.child_mark, std::move(next_state), i, frame.action_utils);
+                        frame.next_action++;
+                        continue;
+                    }
+                    const double r1 = player == 0 ? frame.p1_reach * frame.strategy[i] : frame.p1_reach;
+                    const double r2 = player == 0 ? frame.p2_reach : frame.p2_reach * frame.strategy[i];
+                    double value;
+                    // Положен кадр потомка: ссылка frame могла устареть, но она больше не нужна.
+                    if (enter_node(lane, std::move(next_state), r1, r2, frame.depth + 1, value)) return true;
+                    frame.action_utils[i] = value;
+                    lane.stack.release(frame.child_mark);
+                    frame.next_action++;
+                    continue;
+                }
+
+                flush_leaves(scratch, lane.stack, frame.action_utils);
+                const double util = record_updates(scratch, frame.key_hash, frame.node, frame.hot, player, lane.traverser,
+                                                   frame.p1_reach, frame.p2_reach, frame.strategy, frame.action_utils, num_actions);
+                frames.pop_back();
+                if (frames.empty()) return false;
+                LaneFrame& parent = frames.back();
+                parent.action_utils[parent.next_action] = util;
+                lane.stack.release(parent.child_mark);
+                parent.next_action++;
+            }
+        }
+
+        // Метка отсеченного действия в action_utils: ценность потомка не считалась.
+        static constexpr double PRUNED = std::numeric_limits<double>::quiet_NaN();
+        static inline bool is_pruned(double action_util) { return std::isnan(action_util); }
+
+        // До regret_matching (на входе сожаления): помечает отсекаемые действия узла (SolverConfig::regret_pruning).
+        // action_utils берется из арены потока и может хранить метки прежних обходов (в том числе
+        // другого решателя), поэтому обнуляется здесь, на всех путях обхода, до любой метки.
+        inline void prune_actions(TraversalScratch& scratch, const double* regrets, double* action_utils, int num_actions) {
+            std::fill(action_utils, action_utils + num_actions, 0.0);
+            if (!config_.regret_pruning || iterations_.load(std::memory_order_relaxed) < config_.prune_warmup) return;
+            bool positive = false, below = false;
+            for (int i = 0; i < num_actions; ++i) {
+                positive |= regrets[i] > 0;
+                below |= regrets[i] < config_.prune_threshold;
+            }
+            if (!positive || !below) return;
+            if (config_.prune_explore > 0 && (thread_rng()() >> 11) * 0x1.0p-53 < config_.prune_explore) return;
+            for (int i = 0; i < num_actions; ++i) {
+                if (regrets[i] >= config_.prune_threshold) continue;
+                action_utils[i] = PRUNED;
+                scratch.pruned_edges++;
+            }
+        }
+
+        // Стратегия пропорциональна положительным сожалениям (без них — равномерная); на входе сожаления.
+        static inline void regret_matching(double* strategy, int num_actions) {
             double total_positive_regret = 0.0;
             for (int i = 0; i < num_actions; ++i) {
-                strategy[i] = (node_copy.regret_sum[i] > 0) ? node_copy.regret_sum[i] : 0.0;
+                strategy[i] = (strategy[i] > 0) ? strategy[i] : 0.0;
                 total_positive_regret += strategy[i];
             }
 
             if (total_positive_regret > 0) {
                 for (int i = 0; i < num_actions; ++i) strategy[i] /= total_positive_regret;
             } else {
-                std::fill(strategy.begin(), strategy.end(), 1.0 / num_actions);
+                std::fill(strategy, strategy + num_actions, 1.0 / num_actions);
             }
+        }
 
-            std::vector<std::vector<double>> action_utils(num_actions, std::vector<double>(2));
-            std::vector<double> node_util(2, 0.0);
+        // Сожаления узла в out: горячие узлы (глубина меньше hot_depth) — из снимка потока, тогда hot
+        // указывает на запись кэша; остальные — из таблицы.
+        inline Node* load_node(TraversalScratch& scratch, std::string_view key, uint64_t key_hash, int num_actions, int depth,
+                               double* out, HotNodeCache::Entry*& hot) {
+            hot = depth < config_.hot_depth ? scratch.hot.load(nodes_, key, key_hash, num_actions, out) : nullptr;
+            return hot ? hot->node : nodes_.load_regrets(key, key_hash, num_actions, out);
+        }
 
+        // Ценность узла и запись его сожалений и весов стратегии в журнал потока
+        // (для горячего узла — в его локальные приращения; в режиме hogwild — сразу в узел;
+        // для еще не созданного — никуда). При поочередных обновлениях (traverser >= 0) сожаления
+        // пишутся только в узлах traverser, а веса стратегии — только в узлах соперника.
+        // У отсеченных действий вероятность нулевая, а сожаление не меняется.
+        inline double record_updates(TraversalScratch& scratch, uint64_t key_hash, Node* node, HotNodeCache::Entry* hot, int player,
+                                     int traverser, double p1_reach, double p2_reach, const double* strategy, const double* action_utils,
+                                     int num_actions) {
+            double node_util = 0.0;
             for (int i = 0; i < num_actions; ++i) {
-                GameState next_state = state.apply_action(legal_actions[i]);
-                if (player == 0) action_utils[i] = mccfr_traverse(next_state, p1_reach * strategy[i], p2_reach, local_updates);
-                else action_utils[i] = mccfr_traverse(next_state, p1_reach, p2_reach * strategy[i], local_updates);
-                for (int p = 0; p < 2; ++p) node_util[p] += strategy[i] * action_utils[i][p];
+                if (!is_pruned(action_utils[i])) node_util += strategy[i] * action_utils[i];
             }
+            if (!node) return node_util;
 
-            Update update;
-            update.infoset_key = infoset_key;
-            update.num_actions = num_actions;
-            update.regret_update.resize(num_actions);
-            update.strategy_update.resize(num_actions);
-
+            const double sign = (player == 0) ? 1.0 : -1.0;
+            const double opponent_reach = (player == 0) ? p2_reach : p1_reach;
             double reach_prob = (player == 0) ? p1_reach : p2_reach;
-            for (int i = 0; i < num_actions; ++i) {
-                double regret = action_utils[i][player] - node_util[player];
-                update.regret_update[i] = ((player == 0) ? p2_reach : p1_reach) * regret;
-                update.strategy_update[i] = reach_prob * strategy[i];
+            if (iterations_.load(std::memory_order_relaxed) <= config_.averaging_delay) reach_prob = 0.0;
+            const UpdateKind kind = traverser < 0 ? UPDATE_BOTH : player == traverser ? UPDATE_REGRETS : UPDATE_STRATEGY;
+            const bool regrets = kind != UPDATE_STRATEGY, strategies = kind != UPDATE_REGRETS;
+            if (hot) {
+                double* regret_delta = hot->regret_delta();
+                double* strategy_delta = hot->strategy_delta();
+                for (int i = 0; i < num_actions; ++i) {
+                    if (regrets && !is_pruned(action_utils[i])) regret_delta[i] += opponent_reach * sign * (action_utils[i] - node_util);
+                    if (strategies) strategy_delta[i] += reach_prob * strategy[i];
+                }
+                hot->dirty = true;
+                return node_util;
             }
-            local_updates.push_back(update);
 
+            double* regret_update;
+            double* strategy_update;
+            if (config_.hogwild) {
+                regret_update = hogwild_deltas(scratch, num_actions);
+                strategy_update = regret_update + num_actions;
+                if (!regrets) std::fill(regret_update, regret_update + num_actions, 0.0);
+                if (!strategies) std::fill(strategy_update, strategy_update + num_actions, 0.0);
+            } else {
+                // Запись журнала с одной половиной вдвое короче (UpdateKind).
+                regret_update = scratch.updates.append(key_hash, node, num_actions, kind);
+                strategy_update = kind == UPDATE_BOTH ? regret_update + num_actions : regret_update;
+            }
+            for (int i = 0; i < num_actions; ++i) {
+                if (regrets) regret_update[i] = is_pruned(action_utils[i]) ? 0.0 : opponent_reach * sign * (action_utils[i] - node_util);
+                if (strategies) strategy_update[i] = reach_prob * strategy[i];
+            }
+            if (config_.hogwild) nodes_.encoding().add(node->bytes(), num_actions, regret_update, strategy_update, regrets);
             return node_util;
         }
 
-        std::unordered_map<std::string, Node> nodes_;
-        mutable std::mutex map_mutex_;
+        // Буфер приращений узла для режима hogwild (сначала сожаления, затем веса стратегии).
+        static inline double* hogwild_deltas(TraversalScratch& scratch, int num_actions) {
+            if (scratch.deltas.size() < 2 * (size_t)num_actions) scratch.deltas.resize(2 * (size_t)num_actions);
+            return scratch.deltas.data();
+        }
+
+        // Листья ограниченного по глубине дерева копим и оцениваем пакетами.
+        // Буферы пакета общие для потока: потомки узла либо все листья, либо все нет,
+        // и узел с листьями обходит их без переключения на другие обходы.
+        inline void defer_leaf(TraversalScratch& scratch, ScratchStack& stack, const ScratchStack::Mark& child_mark,
+                               GameState&& leaf, int action, double* action_utils) {
+            if (scratch.leaf_states.empty()) scratch.leaf_mark = child_mark;
+            scratch.leaf_states.push_back(std::move(leaf));
+            scratch.leaf_actions.push_back(action);
+            if ((int)scratch.leaf_states.size() >= config_.leaf_batch_size) flush_leaves(scratch, stack, action_utils);
+        }
+
+        // Оценка накопленных листьев; память их состояний возвращается в арену.
+        inline void flush_leaves(TraversalScratch& scratch, ScratchStack& stack, double* action_utils) {
+            if (scratch.leaf_states.empty()) return;
+            scratch.leaf_batch.clear();
+            for (const GameState& leaf : scratch.leaf_states) scratch.leaf_batch.push_back(&leaf);
+            leaf_estimator_->estimate(scratch.leaf_batch, scratch.leaf_values);
+            for (size_t j = 0; j < scratch.leaf_states.size(); ++j) action_utils[scratch.leaf_actions[j]] = scratch.leaf_values[j];
+            scratch.leaf_states.clear();
+            scratch.leaf_actions.clear();
+            stack.release(scratch.leaf_mark);
+        }
+
+        // Ключ узла, построенный родителем заранее для упреждения (см. SolverConfig::prefetch_distance).
+        struct PrebuiltKey {
+            std::string_view key;
+            uint64_t hash;
+        };
+
+        // Спуск в потомков с упреждением: их состояния и ключи строятся в кадре узла до первого спуска
+        // (кадры потомков освобождаются LIFO поверх них), затем перед спуском в k-й потомок
+        // запрашивается ячейка (k + prefetch_distance)-го. Потомок использует готовый ключ.
+        inline void traverse_children_with_lookahead(const GameState& state, const ActionList& legal_actions, const double* strategy,
+                                                     double p1_reach, double p2_reach, int depth, int traverser,
+                                                     double* action_utils, TraversalScratch& scratch) {
+            std::pmr::memory_resource* arena = &scratch.stack;
+            const int num_actions = legal_actions.size();
+            std::pmr::vector<int> actions(arena);
+            std::pmr::vector<GameState> children(arena);
+            std::pmr::vector<std::pmr::string> keys(arena);
+            std::pmr::vector<uint64_t> hashes(arena);
+            actions.reserve(num_actions);
+            children.reserve(num_actions);
+            for (int i = 0; i < num_actions; ++i) {
+                if (is_pruned(action_utils[i])) continue;
+                actions.push_back(i);
+                children.push_back(state.apply_action(legal_actions[i], arena));
+            }
+            // Улица у потомков общая: либо все терминальны (ключи не нужны), либо ни один.
+            const bool keyed = !children.empty() && !children[0].is_terminal();
+            if (keyed) {
+                keys.reserve(children.size());
+                hashes.reserve(children.size());
+                for (const GameState& child : children) {
+                    keys.emplace_back();  // строка берет арену из аллокатора вектора
+                    keys.back().reserve(64);
+                    append_infoset_key(child, keys.back());
+                    hashes.push_back(NodeTable::hash_key(keys.back()));
+                }
+                for (int k = 0; k < (int)hashes.size() && k < config_.prefetch_distance; ++k) nodes_.prefetch(hashes[k]);
+                scratch.child_prefetches += std::min<long long>(hashes.size(), config_.prefetch_distance);
+            }
+
+            const bool first_player = state.get_current_player() == 0;
+            for (int k = 0; k < (int)children.size(); ++k) {
+                scratch.traversed_edges++;
+                const int ahead = k + config_.prefetch_distance;
+                if (keyed && ahead < (int)hashes.size()) {
+                    nodes_.prefetch(hashes[ahead]);
+                    scratch.child_prefetches++;
+                }
+                const int i = actions[k];
+                const PrebuiltKey key = keyed ? PrebuiltKey{keys[k], hashes[k]} : PrebuiltKey{};
+                const double r1 = first_player ? p1_reach * strategy[i] : p1_reach;
+                const double r2 = first_player ? p2_reach : p2_reach * strategy[i];
+                action_utils[i] = mccfr_traverse(children[k], r1, r2, depth + 1, traverser, scratch, keyed ? &key : nullptr);
+            }
+        }
+
+        // Улица у всех потомков узла общая, поэтому они либо все листья ограниченного дерева, либо все нет.
+        inline bool children_are_leaves(const GameState& state) const {
+            int next_street = state.get_street() + (state.get_current_player() == state.get_dealer_pos() ? 1 : 0);
+            return config_.max_street > 0 && next_street <= 5 && next_street > config_.max_street;
+        }
+
+        // Каждый потомок — отдельная задача: состояние строится и обходится на арене потока,
+        // который ее выполнил. На одном потоке задачи строго вложены (в OpenMP задачи привязанные,
+        // в пуле украденная задача выполняется на стеке ожидающего), поэтому кадры арены
+        // освобождаются в порядке LIFO. Действия, стратегия и полезности лежат в кадре родителя,
+        // который ждет завершения всех задач; там же лежат и записи задач пула.
+        inline void traverse_children_as_tasks(const GameState& state, const ActionList& legal_actions, const double* strategy,
+                                               double p1_reach, double p2_reach, int depth, int traverser, double* action_utils) {
+            const GameState* parent = &state;
+            const bool first_player = state.get_current_player() == 0;
+            const bool use_pool = config_.parallel_backend == PARALLEL_THREAD_POOL && pool_;
+            ChildTask* tasks = use_pool ? static_cast<ChildTask*>(thread_scratch().stack.allocate(
+                                              legal_actions.size() * sizeof(ChildTask), alignof(ChildTask)))
+                                        : nullptr;
+            ThreadPool::TaskGroup group;
+            for (int i = 0; i < (int)legal_actions.size(); ++i) {
+                if (is_pruned(action_utils[i])) continue;
+                thread_scratch().traversed_edges++;
+                const Action* action = &legal_actions[i];
+                double* out = &action_utils[i];
+                double r1 = first_player ? p1_reach * strategy[i] : p1_reach;
+                double r2 = first_player ? p2_reach : p2_reach * strategy[i];
+                if (use_pool) {
+                    tasks[i] = {this, parent, action, out, r1, r2, depth + 1, traverser};
+                    pool_->submit(group, &ChildTask::run, &tasks[i]);
+                    continue;
+                }
+                #pragma omp task default(none) firstprivate(parent, action, out, r1, r2, depth, traverser)
+                *out = traverse_child(*parent, *action, r1, r2, depth + 1, traverser);
+            }
+            if (use_pool) pool_->wait(group);
+            else {
+                #pragma omp taskwait
+            }
+        }
+
+        // Аргументы задачи пула для одного потомка.
+        struct ChildTask {
+            MCCFRSolver* solver;
+            const GameState* parent;
+            const Action* action;
+            double* out;
+            double p1_reach;
+            double p2_reach;
+            int depth;
+            int traverser;
+
+            static void run(void* args) {
+                const ChildTask& t = *static_cast<const ChildTask*>(args);
+                *t.out = t.solver->traverse_child(*t.parent, *t.action, t.p1_reach, t.p2_reach, t.depth, t.traverser);
+            }
+        };
+
+        inline double traverse_child(const GameState& parent, const Action& action, double p1_reach, double p2_reach, int depth,
+                                     int traverser) {
+            TraversalScratch& scratch = thread_scratch();
+            ScratchFrame frame(scratch.stack);
+            GameState next_state = parent.apply_action(action, &scratch.stack);
+            return mccfr_traverse(next_state, p1_reach, p2_reach, depth, traverser, scratch);
+        }
+
+        // Обход возвращает ценность для игрока 0: игра двух игроков с нулевой суммой,
+        // ценность игрока 1 — та же с обратным знаком.
+        // prebuilt — ключ этого состояния, уже построенный родителем (или nullptr).
+        inline double mccfr_traverse(const GameState& state, double p1_reach, double p2_reach, int depth, int traverser,
+                                     TraversalScratch& scratch, const PrebuiltKey* prebuilt = nullptr) {
+            if (state.is_terminal()) {
+                return state.get_payoffs(evaluator_).first;
+            }
+
+            std::pair<float, float> early_payoffs;
+            if (state.get_early_payoffs(evaluator_, early_payoffs)) {
+                return early_payoffs.first;
+            }
+
+            // Все временные данные узла (действия, состояния потомков, ключ, стратегия и полезности)
+            // живут в кадре арены потока и возвращаются при выходе из узла.
+            ScratchFrame frame(scratch.stack);
+            std::pmr::memory_resource* arena = &scratch.stack;
+
+            int player = state.get_current_player();
+            ActionList legal_actions = state.get_legal_actions(arena);
+            if (legal_actions.empty()) {
+                // Этого не должно происходить с новой логикой, но оставим как защиту
+                return mccfr_traverse(state.apply_action({{}, INVALID_CARD}, arena), p1_reach, p2_reach, depth, traverser, scratch);
+            }
+
+            // Фол игрока неизбежен: все его действия дают ему один и тот же результат,
+            // поэтому раскрываем одно, выбранное равномерно (первое смещало бы выборку карт
+            // и ходов соперника), и не копим по этому узлу сожаления.
+            if (state.is_certain_foul(player, evaluator_)) {
+                return mccfr_traverse(state.apply_action(legal_actions[thread_rng()() % legal_actions.size()], arena),
+                                      p1_reach, p2_reach, depth, traverser, scratch);
+            }
+            
+            std::pmr::string infoset_key(arena);
+            if (!prebuilt) {
+                infoset_key.reserve(64);
+                append_infoset_key(state, infoset_key);
+            }
+            const std::string_view key = prebuilt ? prebuilt->key : std::string_view(infoset_key);
+            int num_actions = legal_actions.size();
+
+            double* strategy = frame.alloc(num_actions);
+            double* action_utils = frame.alloc(num_actions);
+
+            const uint64_t key_hash = prebuilt ? prebuilt->hash : NodeTable::hash_key(infoset_key);
+            HotNodeCache::Entry* hot;
+            Node* node = load_node(scratch, key, key_hash, num_actions, depth, strategy, hot);
+            prune_actions(scratch, strategy, action_utils, num_actions);
+            regret_matching(strategy, num_actions);
+
+            if (depth < config_.task_depth && num_actions >= config_.task_min_actions && !children_are_leaves(state)) {
+                traverse_children_as_tasks(state, legal_actions, strategy, p1_reach, p2_reach, depth, traverser, action_utils);
+            } else if (config_.prefetch_distance > 0 && !children_are_leaves(state)) {
+                // Упреждение только там, где потомки читают таблицу: не листья.
+                traverse_children_with_lookahead(state, legal_actions, strategy, p1_reach, p2_reach, depth, traverser,
+                                                 action_utils, scratch);
+            } else {
+                for (int i = 0; i < num_actions; ++i) {
+                    if (is_pruned(action_utils[i])) continue;
+                    scratch.traversed_edges++;
+                    const ScratchStack::Mark child_mark = scratch.stack.mark();
+                    bool is_leaf;
+                    {
+                        GameState next_state = state.apply_action(legal_actions[i], arena);
+                        is_leaf = is_depth_leaf(next_state);
+                        if (is_leaf) {
+                            defer_leaf(scratch, scratch.stack, child_mark, std::move(next_state), i, action_utils);
+                        } else if (player == 0) {
+                            action_utils[i] = mccfr_traverse(next_state, p1_reach * strategy[i], p2_reach, depth + 1, traverser, scratch);
+                        } else {
+                            action_utils[i] = mccfr_traverse(next_state, p1_reach, p2_reach * strategy[i], depth + 1, traverser, scratch);
+                        }
+                    }
+                    // Состояние потомка-листа ждет оценки пакетом; остальные возвращаются в арену сразу.
+                    if (!is_leaf) scratch.stack.release(child_mark);
+                }
+                flush_leaves(scratch, scratch.stack, action_utils);
+            }
+
+            return record_updates(scratch, key_hash, node, hot, player, traverser, p1_reach, p2_reach, strategy, action_utils, num_actions);
+        }
+
+        // Чистое действие стратегии regret matching: вероятность пропорциональна положительному
+        // сожалению, без них — равномерно. На входе сожаления.
+        static inline int sample_action(const double* regrets, int num_actions) {
+            double total = 0.0;
+            for (int i = 0; i < num_actions; ++i) {
+                if (regrets[i] > 0) total += regrets[i];
+            }
+            if (!(total > 0)) return (int)(thread_rng()() % (uint64_t)num_actions);
+            double x = (thread_rng()() >> 11) * 0x1.0p-53 * total;
+            int last = 0;
+            for (int i = 0; i < num_actions; ++i) {
+                if (regrets[i] <= 0) continue;
+                x -= regrets[i];
+                if (x < 0) return i;
+                last = i;
+            }
+            return last;
+        }
+
+        // Куда копить приращения узла: локальные приращения горячего узла или новая (обнуленная)
+        // запись журнала, в режиме hogwild — буфер потока. После заполнения — commit_deltas.
+        inline std::pair<double*, double*> node_deltas(TraversalScratch& scratch, uint64_t key_hash, Node* node,
+                                                       HotNodeCache::Entry* hot, int num_actions) {
+            if (hot) {
+                hot->dirty = true;
+                return {hot->regret_delta(), hot->strategy_delta()};
+            }
+            double* update = config_.hogwild ? hogwild_deltas(scratch, num_actions) : scratch.updates.append(key_hash, node, num_actions);
+            std::fill(update, update + 2 * num_actions, 0.0);
+            return {update, update + num_actions};
+        }
+
+        // Приращения из node_deltas: в режиме hogwild прибавляются к узлу сразу. Итерация Pure CFR
+        // из ранней улицы пишет в журнал сотни тысяч узлов, поэтому журнал сливается
+        // по update_flush_threshold и посреди обхода (узлы таблицы при слиянии не двигаются).
+        inline void commit_deltas(TraversalScratch& scratch, Node* node, HotNodeCache::Entry* hot) {
+            if (config_.hogwild && !hot) {
+                const double* deltas = scratch.deltas.data();
+                nodes_.encoding().add(node->bytes(), node->num_actions, deltas, deltas + node->num_actions);
+            } else if (config_.update_flush_threshold > 0 && config_.regret_matching != RM_PREDICTIVE &&
+                       scratch.updates.value_count() >= (size_t)config_.update_flush_threshold) {
+                nodes_.merge(scratch.updates, current_numa_node());
+            }
+        }
+
+        // Обход Pure CFR (SolverConfig::pure_cfr) за игрока traverser; ценность — для игрока 0.
+        // В узлах traverser раскрываются все действия, и сожаление действия — разность его ценности
+        // и ценности выбранного; в остальных узлах спуск идет только в выбранное действие, а его
+        // вес стратегии растет на 1.
+        inline double pure_traverse(const GameState& state, int traverser, int depth, TraversalScratch& scratch) {
+            if (state.is_terminal()) {
+                return state.get_payoffs(evaluator_).first;
+            }
+
+            std::pair<float, float> early_payoffs;
+            if (state.get_early_payoffs(evaluator_, early_payoffs)) {
+                return early_payoffs.first;
+            }
+
+            ScratchFrame frame(scratch.stack);
+            std::pmr::memory_resource* arena = &scratch.stack;
+
+            int player = state.get_current_player();
+            ActionList legal_actions = state.get_legal_actions(arena);
+            if (legal_actions.empty()) {
+                return pure_traverse(state.apply_action({{}, INVALID_CARD}, arena), traverser, depth, scratch);
+            }
+            if (state.is_certain_foul(player, evaluator_)) {
+                return pure_traverse(state.apply_action(legal_actions[thread_rng()() % legal_actions.size()], arena),
+                                     traverser, depth, scratch);
+            }
+
+            std::pmr::string infoset_key(arena);
+            infoset_key.reserve(64);
+            append_infoset_key(state, infoset_key);
+            int num_actions = legal_actions.size();
+
+            double* regrets = frame.alloc(num_actions);
+            const uint64_t key_hash = NodeTable::hash_key(infoset_key);
+            HotNodeCache::Entry* hot;
+            Node* node = load_node(scratch, infoset_key, key_hash, num_actions, depth, regrets, hot);
+            const int sampled = sample_action(regrets, num_actions);
+
+            if (player != traverser) {
+                if (node && iterations_.load(std::memory_order_relaxed) > config_.averaging_delay) {
+                    node_deltas(scratch, key_hash, node, hot, num_actions).second[sampled] += 1.0;
+                    commit_deltas(scratch, node, hot);
+                }
+                // Базовые значения читаются и обновляются прямо в узле, без блокировки (см. NodeEncoding::baselines).
+                double* baselines = nullptr;
+                double expected_baseline = 0.0;
+                if (config_.vr_baselines && node) {
+                    baselines = frame.alloc(num_actions);
+                    nodes_.encoding().action_baselines(node->bytes(), num_actions, baselines);
+                    regret_matching(regrets, num_actions);
+                    for (int i = 0; i < num_actions; ++i) expected_baseline += regrets[i] * baselines[i];
+                }
+                scratch.traversed_edges++;
+                const ScratchStack::Mark child_mark = scratch.stack.mark();
+                double value;
+                {
+                    GameState next_state = state.apply_action(legal_actions[sampled], arena);
+                    if (!is_depth_leaf(next_state)) {
+                        value = pure_traverse(next_state, traverser, depth + 1, scratch);
+                    } else {
+                        defer_leaf(scratch, scratch.stack, child_mark, std::move(next_state), 0, &value);
+                        flush_leaves(scratch, scratch.stack, &value);
+                    }
+                }
+                if (!baselines) return value;
+                nodes_.encoding().update_baseline(node->bytes(), num_actions, sampled, value, config_.baseline_alpha);
+                return expected_baseline + value - baselines[sampled];
+            }
+
+            double* action_utils = frame.alloc(num_actions);
+            for (int i = 0; i < num_actions; ++i) {
+                scratch.traversed_edges++;
+                const ScratchStack::Mark child_mark = scratch.stack.mark();
+                bool is_leaf;
+                {
+                    GameState next_state = state.apply_action(legal_actions[i], arena);
+                    is_leaf = is_depth_leaf(next_state);
+                    if (is_leaf) defer_leaf(scratch, scratch.stack, child_mark, std::move(next_state), i, action_utils);
+                    else action_utils[i] = pure_traverse(next_state, traverser, depth + 1, scratch);
+                }
+                if (!is_leaf) scratch.stack.release(child_mark);
+            }
+            flush_leaves(scratch, scratch.stack, action_utils);
+
+            if (node) {
+                const double sign = (player == 0) ? 1.0 : -1.0;
+                double* regret_delta = node_deltas(scratch, key_hash, node, hot, num_actions).first;
+                for (int i = 0; i < num_actions; ++i) regret_delta[i] += sign * (action_utils[i] - action_utils[sampled]);
+                commit_deltas(scratch, node, hot);
+            }
+            return action_utils[sampled];
+        }
+
+        NodeTable nodes_;
+        NumaTopology numa_topology_;
+        std::atomic<long long> arena_refills_{0};
+        std::atomic<long long> child_prefetches_{0};
+        std::atomic<long long> iterations_{0};
+        std::atomic<long long> traversed_edges_{0};
+        std::atomic<long long> pruned_edges_{0};
+        std::unique_ptr<ThreadPool> pool_;
         HandEvaluator evaluator_;
+        SolverConfig config_;
+        std::shared_ptr<const LeafEstimator> leaf_estimator_;
+    };
+
+    struct ArenaBenchmarkResult {
+        int iterations = 0;
+        long long warmup_refills = 0;
+        long long steady_refills = 0;
+        long long nodes = 0;
+        double seconds = 0.0;
+    };
+
+    // Итерации обхода из случайных позиций улицы street в одном потоке: сколько пополнений арен
+    // и журналов (get_arena_refills) понадобилось на первой итерации (прогрев) и на всех
+    // остальных (в норме — 0).
+    inline ArenaBenchmarkResult benchmark_arena(int street, int iterations, uint64_t seed) {
+        if (iterations < 2) throw std::invalid_argument("Arena benchmark needs at least 2 iterations");
+        MCCFRSolver solver;
+        std::vector<GameState> roots = sample_positions(street, iterations, seed);
+
+        ArenaBenchmarkResult result;
+        result.iterations = iterations;
+        auto t0 = std::chrono::steady_clock::now();
+        for (int i = 0; i < iterations; ++i) {
+            solver.train_from(roots[i]);
+            if (i == 0) result.warmup_refills = solver.get_arena_refills();
+        }
+        result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+        result.steady_refills = solver.get_arena_refills() - result.warmup_refills;
+        result.nodes = solver.get_node_count();
+        return result;
+    }
+
+    struct NumaBenchmarkResult {
+        int numa_nodes = 0;
+        int threads = 0;
+        int positions = 0;
+        long long nodes = 0;
+        double local_seconds = 0.0;
+        double interleaved_seconds = 0.0;
+        int bind_failures = 0;
+    };
+
+    // Одинаковое обучение из positions случайных позиций улицы street (passes проходов) на пуле
+    // из threads закрепленных потоков: таблица по сокетам с пересылкой обновлений владельцу
+    // (NUMA_LOCAL) против страниц, чередующихся по всем сокетам (NUMA_INTERLEAVE).
+    // На машине с одним узлом NUMA режимы совпадают по сути, и время сравнимо.
+    inline NumaBenchmarkResult benchmark_numa(int street, int positions, int passes, int threads, uint64_t seed) {
+        if (positions < 1 || passes < 1) throw std::invalid_argument("NUMA benchmark needs positions >= 1 and passes >= 1");
+        std::vector<GameState> roots = sample_positions(street, positions, seed);
+
+        NumaBenchmarkResult result;
+        result.numa_nodes = NumaTopology::detect().num_nodes();
+        result.positions = positions;
+        for (NumaMode mode : {NUMA_LOCAL, NUMA_INTERLEAVE}) {
+            MCCFRSolver solver;
+            SolverConfig config;
+            config.parallel_backend = PARALLEL_THREAD_POOL;
+            config.num_threads = threads;
+            config.pin_threads = 1;
+            config.numa_mode = mode;
+            solver.set_config(config);
+            result.threads = solver.get_num_threads();
+
+            auto t0 = std::chrono::steady_clock::now();
+            for (int p = 0; p < passes; ++p) solver.train_positions(roots);
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+            if (mode == NUMA_LOCAL) {
+                result.local_seconds = seconds;
+                result.nodes = solver.get_node_count();
+            } else {
+                result.interleaved_seconds = seconds;
+            }
+            result.bind_failures += solver.get_numa_bind_failures();
+        }
+        return result;
+    }
+
+    struct InterleaveBenchmarkResult {
+        int positions = 0;
+        int width = 0;
+        long long nodes = 0;
+        double serial_seconds = 0.0;
+        double interleaved_seconds = 0.0;
+    };
+
+    // Один поток, positions случайных позиций улицы street: рекурсивный обход против width
+    // чередующихся обходов. Первый проход заполняет таблицу, время меряется на втором,
+    // где все чтения попадают в существующие узлы.
+    inline InterleaveBenchmarkResult benchmark_interleave(int street, int positions, int width, uint64_t seed) {
+        if (positions < 1 || width < 1) throw std::invalid_argument("Interleave benchmark needs positions >= 1 and width >= 1");
+        std::vector<GameState> roots = sample_positions(street, positions, seed);
+
+        InterleaveBenchmarkResult result;
+        result.positions = positions;
+        result.width = width;
+        for (int interleave : {0, width}) {
+            MCCFRSolver solver;
+            SolverConfig config;
+            config.num_threads = 1;
+            config.interleave_traversals = interleave;
+            solver.set_config(config);
+            solver.train_positions(roots);
+
+            auto t0 = std::chrono::steady_clock::now();
+            solver.train_positions(roots);
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+            if (interleave == 0) result.serial_seconds = seconds;
+            else result.interleaved_seconds = seconds;
+            result.nodes = solver.get_node_count();
+        }
+        return result;
+    }
+
+    struct PrefetchBenchmarkResult {
+        int positions = 0;
+        int distance = 0;
+        long long nodes = 0;
+        long long prefetches = 0;
+        double baseline_seconds = 0.0;
+        double prefetch_seconds = 0.0;
+        // Промахи кэша последнего уровня (perf_event); -1 — счетчик недоступен.
+        long long baseline_cache_misses = -1;
+        long long prefetch_cache_misses = -1;
+    };
+
+    // Один поток, positions случайных позиций улицы street: рекурсивный обход без упреждения
+    // и с упреждением на distance потомков. Первый проход заполняет таблицу (размер таблицы
+    // растет с positions), время и промахи кэша меряются на втором.
+    inline PrefetchBenchmarkResult benchmark_prefetch(int street, int positions, int distance, uint64_t seed) {
+        if (positions < 1 || distance < 1) throw std::invalid_argument("Prefetch benchmark needs positions >= 1 and distance >= 1");
+        std::vector<GameState> roots = sample_positions(street, positions, seed);
+
+        PrefetchBenchmarkResult result;
+        result.positions = positions;
+        result.distance = distance;
+        for (int d : {0, distance}) {
+            MCCFRSolver solver;
+            SolverConfig config;
+            config.num_threads = 1;
+            config.prefetch_distance = d;
+            solver.set_config(config);
+            solver.train_positions(roots);
+
+            CacheMissCounter misses;
+            const long long prefetches_before = solver.get_child_prefetches();
+            auto t0 = std::chrono::steady_clock::now();
+            misses.start();
+            solver.train_positions(roots);
+            const long long miss_count = misses.stop();
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+            if (d == 0) {
+                result.baseline_seconds = seconds;
+                result.baseline_cache_misses = miss_count;
+            } else {
+                result.prefetch_seconds = seconds;
+                result.prefetch_cache_misses = miss_count;
+                result.prefetches = solver.get_child_prefetches() - prefetches_before;
+            }
+            result.nodes = solver.get_node_count();
+        }
+        return result;
+    }
+
+    struct LazyNodesBenchmarkResult {
+        int positions = 0;
+        int passes = 0;
+        int visits = 0;
+        long long eager_nodes = 0;
+        long long lazy_nodes = 0;
+        long long lazy_counters = 0;
+        // Занято таблицей (записи и индекс) — столько страниц слябов затронуто.
+        long long eager_bytes = 0;
+        long long lazy_bytes = 0;
+        double eager_seconds = 0.0;
+        double lazy_seconds = 0.0;
+        // Pure CFR на тех же позициях: таблица с весами стратегии в каждой записи и с lazy_strategy_sums.
+        long long pure_nodes = 0;
+        long long pure_eager_bytes = 0;
+        long long pure_lazy_bytes = 0;
+    };
+
+    // positions случайных позиций улицы street, passes проходов обучения в одном потоке: таблица
+    // с созданием узла при первом посещении против создания на visits-м посещении, затем
+    // Pure CFR с весами стратегии в записи против отдельных блоков весов (lazy_strategy_sums).
+    inline LazyNodesBenchmarkResult benchmark_lazy_nodes(int street, int positions, int passes, int visits, uint64_t seed) {
+        if (positions < 1 || passes < 1 || visits < 2) throw std::invalid_argument("Lazy nodes benchmark needs positions >= 1, passes >= 1 and visits >= 2");
+        std::vector<GameState> roots = sample_positions(street, positions, seed);
+
+        LazyNodesBenchmarkResult result;
+        result.positions = positions;
+        result.passes = passes;
+        result.visits = visits;
+        for (int v : {1, visits}) {
+            MCCFRSolver solver;
+            SolverConfig config;
+            config.num_threads = 1;
+            config.materialize_visits = v;
+            solver.set_config(config);
+
+            auto t0 = std::chrono::steady_clock::now();
+            for (int p = 0; p < passes; ++p) solver.train_positions(roots);
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+            if (v == 1) {
+                result.eager_seconds = seconds;
+                result.eager_nodes = solver.get_node_count();
+                result.eager_bytes = solver.get_table_used_bytes();
+            } else {
+                result.lazy_seconds = seconds;
+                result.lazy_nodes = solver.get_node_count();
+                result.lazy_counters = solver.get_node_counter_count();
+                result.lazy_bytes = solver.get_table_used_bytes();
+            }
+        }
+        for (int lazy : {0, 1}) {
+            MCCFRSolver solver;
+            SolverConfig config;
+            config.num_threads = 1;
+            config.storage = STORAGE_INT32;
+            config.pure_cfr = 1;
+            config.lazy_strategy_sums = lazy;
+            solver.set_config(config);
+            for (int p = 0; p < passes; ++p) solver.train_positions(roots);
+            result.pure_nodes = solver.get_node_count();
+            (lazy ? result.pure_lazy_bytes : result.pure_eager_bytes) = solver.get_table_used_bytes();
+        }
+        return result;
+    }
+
+    struct HogwildBenchmarkResult {
+        int positions = 0;
+        int threads = 0;
+        long long nodes = 0;
+        // После каждого прохода: время с начала обучения и средний регрет (MCCFRSolver::get_mean_regret).
+        std::vector<double> locked_seconds;
+        std::vector<double> locked_regret;
+        std::vector<double> hogwild_seconds;
+        std::vector<double> hogwild_regret;
+    };
+
+    // Сходимость по времени: positions случайных позиций улицы street, passes проходов на пуле
+    // из threads потоков — журнал со слиянием под блокировками шардов против hogwild.
+    inline HogwildBenchmarkResult benchmark_hogwild(int street, int positions, int passes, int threads, uint64_t seed) {
+        if (positions < 1 || passes < 1) throw std::invalid_argument("Hogwild benchmark needs positions >= 1 and passes >= 1");
+        std::vector<GameState> roots = sample_positions(street, positions, seed);
+
+        HogwildBenchmarkResult result;
+        result.positions = positions;
+        for (int hogwild : {0, 1}) {
+            MCCFRSolver solver;
+            SolverConfig config;
+            config.parallel_backend = PARALLEL_THREAD_POOL;
+            config.num_threads = threads;
+            config.hogwild = hogwild;
+            solver.set_config(config);
+            result.threads = solver.get_num_threads();
+
+            std::vector<double>& seconds = hogwild ? result.hogwild_seconds : result.locked_seconds;
+            std::vector<double>& regret = hogwild ? result.hogwild_regret : result.locked_regret;
+            double elapsed = 0.0;
+            for (int p = 0; p < passes; ++p) {
+                auto t0 = std::chrono::steady_clock::now();
+                solver.train_positions(roots);
+                elapsed += std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+                seconds.push_back(elapsed);
+                regret.push_back(solver.get_mean_regret());
+            }
+            result.nodes = solver.get_node_count();
+        }
+        return result;
+    }
+
+    struct BaselineBenchmarkResult {
+        int positions = 0;
+        int passes = 0;
+        long long nodes = 0;
+        // Дисперсия ценности корня между проходами (средняя по позициям), время обучения
+        // в одном потоке и средний регрет (MCCFRSolver::get_mean_regret) в конце.
+        double plain_variance = 0.0;
+        double baseline_variance = 0.0;
+        double plain_seconds = 0.0;
+        double baseline_seconds = 0.0;
+        double plain_regret = 0.0;
+        double baseline_regret = 0.0;
+    };
+
+    // Pure CFR в одном потоке без базовых значений и с ними (vr_baselines): passes проходов
+    // по positions случайным позициям улицы street. Первый проход — прогрев базовых значений,
+    // дисперсия ценности каждой позиции считается по остальным.
+    inline BaselineBenchmarkResult benchmark_baselines(int street, int positions, int passes, uint64_t seed) {
+        if (positions < 1 || passes < 3) throw std::invalid_argument("Baseline benchmark needs positions >= 1 and passes >= 3");
+        std::vector<GameState> roots = sample_positions(street, positions, seed);
+
+        BaselineBenchmarkResult result;
+        result.positions = positions;
+        result.passes = passes;
+        for (int baselines : {0, 1}) {
+            MCCFRSolver solver;
+            SolverConfig config;
+            config.num_threads = 1;
+            config.storage = STORAGE_INT32;
+            config.pure_cfr = 1;
+            config.vr_baselines = baselines;
+            solver.set_config(config);
+
+            std::vector<double> sum(positions, 0.0), sum_sq(positions, 0.0);
+            auto t0 = std::chrono::steady_clock::now();
+            for (int p = 0; p < passes; ++p) {
+                for (int i = 0; i < positions; ++i) {
+                    const double util = solver.train_from(roots[i]);
+                    if (p == 0) continue;
+                    sum[i] += util;
+                    sum_sq[i] += util * util;
+                }
+            }
+            const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+            const int samples = passes - 1;
+            double variance = 0.0;
+            for (int i = 0; i < positions; ++i) {
+                const double mean = sum[i] / samples;
+                variance += (sum_sq[i] - samples * mean * mean) / (samples - 1);
+            }
+            variance /= positions;
+            (baselines ? result.baseline_variance : result.plain_variance) = variance;
+            (baselines ? result.baseline_seconds : result.plain_seconds) = seconds;
+            (baselines ? result.baseline_regret : result.plain_regret) = solver.get_mean_regret();
+            result.nodes = solver.get_node_count();
+        }
+        return result;
+    }
+
+    struct ScheduleBenchmarkResult {
+        int positions = 0;
+        int passes = 0;
+        int interval = 0;
+        long long nodes = 0;
+        // По расписаниям UpdateSchedule (SCHEDULE_VANILLA .. SCHEDULE_CFR_PLUS): время обучения
+        // в одном потоке и средний регрет (MCCFRSolver::get_mean_regret) в конце.
+        std::vector<double> seconds;
+        std::vector<double> regret;
     };
+
+    // Сходимость и цена дисконтирования: passes проходов по positions случайным позициям улицы
+    // street в одном потоке для каждого расписания с интервалом interval итераций.
+    inline ScheduleBenchmarkResult benchmark_schedules(int street, int positions, int passes, int interval, uint64_t seed) {
+        if (positions < 1 || passes < 1 || interval < 1) throw std::invalid_argument("Schedule benchmark needs positions, passes and interval >= 1");
+        std::vector<GameState> roots = sample_positions(street, positions, seed);
+
+        ScheduleBenchmarkResult result;
+        result.positions = positions;
+        result.passes = passes;
+        result.interval = interval;
+        for (int schedule = SCHEDULE_VANILLA; schedule <= SCHEDULE_CFR_PLUS; ++schedule) {
+            MCCFRSolver solver;
+            SolverConfig config;
+            config.num_threads = 1;
+            config.schedule = schedule;
+            config.discount_interval = interval;
+            solver.set_config(config);
+
+            auto t0 = std::chrono::steady_clock::now();
+            for (int p = 0; p < passes; ++p) solver.train_positions(roots);
+            result.seconds.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count());
+            result.regret.push_back(solver.get_mean_regret());
+            result.nodes = solver.get_node_count();
+        }
+        return result;
+    }
 }
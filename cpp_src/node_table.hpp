@@ -0,0 +1,1062 @@
+// mccfr_ofc-main/cpp_src/node_table.hpp
+
+#pragma once
+#include "slab_arena.hpp"
+#include <vector>
+#include <string>
+#include <string_view>
+#include <memory_resource>
+#include <mutex>
+#include <array>
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <new>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <limits>
+#include <unordered_map>
+
+namespace ofc {
+
+    enum NodeStorage {
+        STORAGE_DOUBLE = 0,   // сожаления и веса стратегии в double
+        STORAGE_FLOAT = 1,    // оба накопителя в float: вдвое меньше памяти
+        STORAGE_INT32 = 2     // сожаления в int32 с масштабом и нижней границей, веса стратегии в float
+    };
+
+    // Кодирование накопителей узла. В STORAGE_INT32 сожаление хранится как round(r * regret_scale)
+    // и не опускается ниже regret_floor: сильно отрицательные сожаления все равно дают нулевую
+    // вероятность, а граница держит их в диапазоне int32 и позволяет действию вернуться в игру.
+    //
+    // При top_k > 0 узлы с числом действий больше top_k (широкие узлы первых улиц) хранятся
+    // разреженно: номера top_k действий с наибольшим сожалением, их сожаления и веса стратегии,
+    // и общий «пол» — одно сожаление за все остальные действия (среднее их сожалений) и сумма
+    // их весов стратегии. Память узла ограничена top_k. Обход по-прежнему раскрывает все
+    // действия, поэтому в add() действие из-под пола, чье сожаление (пол + приращение) превысило
+    // худшее из хранимых, сразу занимает его место — отсеченные действия возвращаются сами.
+    //
+    // predictive (Predictive CFR+) добавляет узлу прогноз — последнее мгновенное сожаление
+    // (сумму приращений последнего слияния), в точности весов стратегии и без границ сожалений.
+    // Стратегия тогда строится по сожалениям плюс прогноз (predicted_regrets).
+    //
+    // baselines (VR-MCCFR) добавляет узлу базовые значения действий — скользящее среднее ценности
+    // потомка, в точности весов стратегии. Это оценка, а не накопитель: она обновляется на месте
+    // (update_baseline) без журнала, не дисконтируется, а у разреженного узла действия под полом
+    // делят одно значение пола.
+    //
+    // lazy_strategies: вместо весов стратегии запись хранит указатель на отдельный блок с ними,
+    // который таблица выделяет при первом ненулевом весе (NodeTable::ensure_strategies); до того
+    // указатель нулевой и все веса равны нулю. Так узлы, в которых стратегия не копится (Pure CFR
+    // копит ее только в узлах соперника выбирающего игрока, averaging_delay), не занимают под нее
+    // места. Только без прогнозов и базовых значений: указатель — последнее поле записи.
+    //
+    // epochs: в конце записи — номер эпохи дисконтирования (uint32), до которой узел дисконтирован
+    // (см. NodeTable::discount). Эпоха и lazy_strategies в файл стратегии не пишутся (file_bytes).
+    struct NodeEncoding {
+        NodeStorage storage = STORAGE_DOUBLE;
+        double regret_scale = 1000.0;
+        double regret_floor = -1e6;
+        int top_k = 0;
+        // CFR+: накопленное сожаление не опускается ниже нуля.
+        bool regret_plus = false;
+        bool predictive = false;
+        bool baselines = false;
+        bool lazy_strategies = false;
+        bool epochs = false;
+
+        inline bool operator==(const NodeEncoding& other) const {
+            return storage == other.storage && regret_scale == other.regret_scale && regret_floor == other.regret_floor &&
+                   top_k == other.top_k && regret_plus == other.regret_plus && predictive == other.predictive &&
+                   baselines == other.baselines && lazy_strategies == other.lazy_strategies &&
+                   epochs == other.epochs;
+        }
+        inline bool operator!=(const NodeEncoding& other) const { return !(*this == other); }
+
+        inline size_t regret_bytes() const { return storage == STORAGE_DOUBLE ? sizeof(double) : sizeof(int32_t); }
+        inline size_t strategy_bytes() const { return storage == STORAGE_DOUBLE ? sizeof(double) : sizeof(float); }
+        inline bool sparse(int num_actions) const { return top_k > 0 && num_actions > top_k && num_actions <= MAX_SPARSE_ACTIONS; }
+
+        // Байт на узел. Плотный: num_actions сожалений, num_actions весов стратегии, (predictive)
+        // num_actions прогнозов и (baselines) базовых значений. Разреженный: top_k номеров действий
+        // (uint16), затем по top_k + 1 сожалений, весов, прогнозов и базовых значений (последние — пол).
+        // При lazy_strategies веса заменены указателем на блок из strategy_block_bytes; epochs добавляет эпоху.
+        inline size_t node_bytes(int num_actions) const {
+            return epoch_offset(num_actions) + (epochs ? sizeof(uint32_t) : 0);
+        }
+
+        // Байт узла в файле стратегии: веса на месте, без эпохи.
+        inline size_t file_bytes(int num_actions) const {
+            const size_t values = value_count(num_actions);
+            return regret_offset(num_actions) + values * (regret_bytes() + strategy_bytes() + (predictive ? strategy_bytes() : 0) +
+                                                          (baselines ? strategy_bytes() : 0));
+        }
+
+        inline uint32_t epoch(const std::byte* data, int num_actions) const { return load<uint32_t>(data + epoch_offset(num_actions), 0); }
+        inline void set_epoch(std::byte* data, int num_actions, uint32_t epoch) const { store<uint32_t>(data + epoch_offset(num_actions), 0, epoch); }
+
+        inline size_t strategy_block_bytes(int num_actions) const { return value_count(num_actions) * strategy_bytes(); }
+
+        // Есть ли у записи место под веса стратегии (без lazy_strategies — всегда).
+        inline bool has_strategies(const std::byte* data, int num_actions) const {
+            return !lazy_strategies || lazy_block(data, num_actions) != nullptr;
+        }
+
+        // Подключает записи обнуляемый блок весов (strategy_block_bytes, выровнен на 8).
+        inline void attach_strategies(std::byte* data, int num_actions, std::byte* block) const {
+            std::memset(block, 0, strategy_block_bytes(num_actions));
+            std::memcpy(data + strategy_offset(num_actions), &block, sizeof(block));
+        }
+
+        // Запись в раскладке файла стратегии (file_bytes; отсутствующий блок весов — нули).
+        inline void copy_inline(const std::byte* data, int num_actions, std::byte* out) const {
+            const size_t head = strategy_offset(num_actions);
+            std::memcpy(out, data, head);
+            if (!lazy_strategies) {
+                std::memcpy(out + head, data + head, file_bytes(num_actions) - head);
+                return;
+            }
+            const std::byte* block = lazy_block(data, num_actions);
+            if (block) std::memcpy(out + head, block, strategy_block_bytes(num_actions));
+            else std::memset(out + head, 0, strategy_block_bytes(num_actions));
+        }
+
+        // Нулевой узел: нули всех кодировок — нулевые байты, хранимые действия разреженного — первые top_k.
+        inline void init(std::byte* data, int num_actions) const {
+            std::memset(data, 0, node_bytes(num_actions));
+            if (!sparse(num_actions)) return;
+            for (int j = 0; j < top_k; ++j) store<uint16_t>(data, j, (uint16_t)j);
+        }
+
+        inline void regrets(const std::byte* data, int num_actions, double* out) const {
+            expand(data, num_actions, regret_values(data, num_actions), out, [this](const std::byte* base, int i) { return regret(base, i); });
+        }
+
+        // Веса стратегии; у разреженного узла сумма пола делится поровну между действиями под ним.
+        inline void strategies(const std::byte* data, int num_actions, double* out) const {
+            const std::byte* base = strategy_values(data, num_actions);
+            if (!base) {
+                std::fill(out, out + num_actions, 0.0);
+                return;
+            }
+            if (!sparse(num_actions)) {
+                for (int a = 0; a < num_actions; ++a) out[a] = strategy(base, a);
+                return;
+            }
+            std::fill(out, out + num_actions, strategy(base, top_k) / (num_actions - top_k));
+            for (int j = 0; j < top_k; ++j) out[action_of(data, j)] = strategy(base, j);
+        }
+
+        // Прогнозы (нули, если узлы без них).
+        inline void predictions(const std::byte* data, int num_actions, double* out) const {
+            if (!predictive) {
+                std::fill(out, out + num_actions, 0.0);
+                return;
+            }
+            expand(data, num_actions, prediction_values(data, num_actions), out, [this](const std::byte* base, int i) { return strategy(base, i); });
+        }
+
+        // Базовые значения действий (нули, если узлы без них).
+        inline void action_baselines(const std::byte* data, int num_actions, double* out) const {
+            if (!baselines) {
+                std::fill(out, out + num_actions, 0.0);
+                return;
+            }
+            expand(data, num_actions, baseline_values(data, num_actions), out, [this](const std::byte* base, int i) { return strategy(base, i); });
+        }
+
+        // Базовое значение действия сдвигается к наблюденной ценности: b += alpha * (value - b).
+        // У разреженного узла действие под полом сдвигает значение пола.
+        inline void update_baseline(std::byte* data, int num_actions, int action, double value, double alpha) const {
+            if (!baselines) return;
+            int i = action;
+            if (sparse(num_actions)) {
+                i = top_k;
+                for (int j = 0; j < top_k; ++j) {
+                    if (action_of(data, j) == action) { i = j; break; }
+                }
+            }
+            std::byte* base = baseline_values(data, num_actions);
+            const double b = strategy(base, i);
+            set_strategy(base, i, b + alpha * (value - b));
+        }
+
+        // Сожаления для построения стратегии: с прогнозом, если он хранится.
+        inline void predicted_regrets(const std::byte* data, int num_actions, double* out) const {
+            regrets(data, num_actions, out);
+            if (!predictive) return;
+            const std::byte* base = prediction_values(data, num_actions);
+            if (!sparse(num_actions)) {
+                for (int a = 0; a < num_actions; ++a) out[a] += strategy(base, a);
+                return;
+            }
+            const double floor_prediction = strategy(base, top_k);
+            for (int a = 0; a < num_actions; ++a) out[a] += floor_prediction;
+            for (int j = 0; j < top_k; ++j) out[action_of(data, j)] += strategy(base, j) - floor_prediction;
+        }
+
+        // Запись значений узла (загрузка стратегии, перекодирование): разреженный хранит top_k лучших по сожалению.
+        // Веса записи без блока (lazy_strategies) должны быть нулевыми.
+        inline void assign(std::byte* data, int num_actions, const double* regret_values_in, const double* strategy_values_in,
+                           const double* prediction_values_in = nullptr, const double* baseline_values_in = nullptr) const {
+            std::byte* regret_base = regret_values(data, num_actions);
+            std::byte* strategy_base = strategy_values(data, num_actions);
+            std::byte* prediction_base = predictive ? prediction_values(data, num_actions) : nullptr;
+            std::byte* baseline_base = baselines ? baseline_values(data, num_actions) : nullptr;
+            auto prediction_of = [&](int a) { return prediction_values_in ? prediction_values_in[a] : 0.0; };
+            auto baseline_of = [&](int a) { return baseline_values_in ? baseline_values_in[a] : 0.0; };
+            if (!sparse(num_actions)) {
+                for (int a = 0; a < num_actions; ++a) {
+                    set_regret(regret_base, a, regret_values_in[a]);
+                    if (strategy_base) set_strategy(strategy_base, a, strategy_values_in[a]);
+                    if (prediction_base) set_strategy(prediction_base, a, prediction_of(a));
+                    if (baseline_base) set_strategy(baseline_base, a, baseline_of(a));
+                }
+                return;
+            }
+            thread_local std::vector<int> order;
+            order.resize(num_actions);
+            for (int a = 0; a < num_actions; ++a) order[a] = a;
+            std::nth_element(order.begin(), order.begin() + top_k, order.end(),
+                             [&](int a, int b) { return regret_values_in[a] > regret_values_in[b]; });
+            double floor_regret = 0.0, floor_strategy = 0.0, floor_prediction = 0.0, floor_baseline = 0.0;
+            for (int r = top_k; r < num_actions; ++r) {
+                floor_regret += regret_values_in[order[r]];
+                floor_strategy += strategy_values_in[order[r]];
+                floor_prediction += prediction_of(order[r]);
+                floor_baseline += baseline_of(order[r]);
+            }
+            for (int j = 0; j < top_k; ++j) {
+                store<uint16_t>(data, j, (uint16_t)order[j]);
+                set_regret(regret_base, j, regret_values_in[order[j]]);
+                if (strategy_base) set_strategy(strategy_base, j, strategy_values_in[order[j]]);
+                if (prediction_base) set_strategy(prediction_base, j, prediction_of(order[j]));
+                if (baseline_base) set_strategy(baseline_base, j, baseline_of(order[j]));
+            }
+            set_regret(regret_base, top_k, floor_regret / (num_actions - top_k));
+            if (strategy_base) set_strategy(strategy_base, top_k, floor_strategy);
+            if (prediction_base) set_strategy(prediction_base, top_k, floor_prediction / (num_actions - top_k));
+            if (baseline_base) set_strategy(baseline_base, top_k, floor_baseline / (num_actions - top_k));
+        }
+
+        // Прибавление приращений из журнала. Int32 прибавляется в масштабированных единицах,
+        // без обратного перевода в double. Прогноз — сумма приращений узла за одно слияние:
+        // restart_prediction у первой записи узла в слиянии. Без блока весов (lazy_strategies)
+        // приращения весов должны быть нулевыми.
+        inline void add(std::byte* data, int num_actions, const double* regret_delta, const double* strategy_delta,
+                        bool restart_prediction = true) const {
+            std::byte* regret_base = regret_values(data, num_actions);
+            std::byte* strategy_base = strategy_values(data, num_actions);
+            std::byte* prediction_base = predictive ? prediction_values(data, num_actions) : nullptr;
+            if (!sparse(num_actions)) {
+                for (int a = 0; a < num_actions; ++a) {
+                    add_regret(regret_base, a, regret_delta[a]);
+                    if (strategy_base) set_strategy(strategy_base, a, strategy(strategy_base, a) + strategy_delta[a]);
+                    if (prediction_base) set_strategy(prediction_base, a, (restart_prediction ? 0.0 : strategy(prediction_base, a)) + regret_delta[a]);
+                }
+                return;
+            }
+            if (prediction_base && restart_prediction) {
+                for (int j = 0; j <= top_k; ++j) set_strategy(prediction_base, j, 0.0);
+            }
+            thread_local std::vector<char> kept;
+            kept.assign(num_actions, 0);
+            int worst = 0;
+            for (int j = 0; j < top_k; ++j) {
+                const int a = action_of(data, j);
+                kept[a] = 1;
+                add_regret(regret_base, j, regret_delta[a]);
+                if (strategy_base) set_strategy(strategy_base, j, strategy(strategy_base, j) + strategy_delta[a]);
+                if (prediction_base) set_strategy(prediction_base, j, strategy(prediction_base, j) + regret_delta[a]);
+                if (regret(regret_base, j) < regret(regret_base, worst)) worst = j;
+            }
+
+            const double floor_regret = regret(regret_base, top_k);
+            double floor_delta = 0.0, floor_strategy = strategy_base ? strategy(strategy_base, top_k) : 0.0;
+            int below = 0;
+            for (int a = 0; a < num_actions; ++a) {
+                if (kept[a]) continue;
+                const double candidate = floor_regret + regret_delta[a];
+                if (candidate <= regret(regret_base, worst)) {
+                    floor_delta += regret_delta[a];
+                    floor_strategy += strategy_delta[a];
+                    below++;
+                    continue;
+                }
+                // Вытесняемое действие уходит под пол: его вес стратегии — в сумму пола.
+                if (strategy_base) floor_strategy += strategy(strategy_base, worst);
+                store<uint16_t>(data, worst, (uint16_t)a);
+                set_regret(regret_base, worst, candidate);
+                if (strategy_base) set_strategy(strategy_base, worst, strategy_delta[a]);
+                if (prediction_base) set_strategy(prediction_base, worst, regret_delta[a]);
+                if (baselines) set_strategy(baseline_values(data, num_actions), worst, strategy(baseline_values(data, num_actions), top_k));
+                for (int j = 0; j < top_k; ++j) if (regret(regret_base, j) < regret(regret_base, worst)) worst = j;
+            }
+            // Пол — среднее оставшихся под ним; вытесненные действия получают его значение.
+            if (below) {
+                set_regret(regret_base, top_k, floor_regret + floor_delta / below);
+                if (prediction_base) set_strategy(prediction_base, top_k, strategy(prediction_base, top_k) + floor_delta / below);
+            }
+            if (strategy_base) set_strategy(strategy_base, top_k, floor_strategy);
+        }
+
+        // Дисконтирование накопленного (Linear CFR, DCFR): положительные сожаления умножаются
+        // на positive, отрицательные — на negative, веса стратегии — на strategy_factor.
+        // У разреженного узла так же масштабируются пол и его сумма; порядок действий не меняется.
+        // Прогноз — мгновенное сожаление, он не дисконтируется.
+        inline void discount(std::byte* data, int num_actions, double positive, double negative, double strategy_factor) const {
+            const int count = sparse(num_actions) ? top_k + 1 : num_actions;
+            std::byte* regret_base = regret_values(data, num_actions);
+            std::byte* strategy_base = strategy_values(data, num_actions);
+            for (int i = 0; i < count; ++i) {
+                const double r = regret(regret_base, i);
+                set_regret(regret_base, i, r * (r > 0 ? positive : negative));
+                if (strategy_base) set_strategy(strategy_base, i, strategy(strategy_base, i) * strategy_factor);
+            }
+        }
+
+    private:
+        // Номер действия — uint16 в разреженном узле.
+        static constexpr int MAX_SPARSE_ACTIONS = 1 << 16;
+
+        inline int action_of(const std::byte* data, int j) const { return load<uint16_t>(data, j); }
+
+        // Начала массивов сожалений, весов, прогнозов и базовых значений узла.
+        inline size_t regret_offset(int num_actions) const { return sparse(num_actions) ? (size_t)top_k * sizeof(uint16_t) : 0; }
+        inline size_t value_count(int num_actions) const { return (size_t)(sparse(num_actions) ? top_k + 1 : num_actions); }
+        inline size_t strategy_offset(int num_actions) const { return regret_offset(num_actions) + value_count(num_actions) * regret_bytes(); }
+        inline size_t strategy_region_bytes(int num_actions) const {
+            return lazy_strategies ? sizeof(std::byte*) : value_count(num_actions) * strategy_bytes();
+        }
+        inline size_t prediction_offset(int num_actions) const { return strategy_offset(num_actions) + strategy_region_bytes(num_actions); }
+        inline size_t baseline_offset(int num_actions) const {
+            return prediction_offset(num_actions) + (predictive ? value_count(num_actions) * strategy_bytes() : 0);
+        }
+        inline size_t epoch_offset(int num_actions) const {
+            return baseline_offset(num_actions) + (baselines ? value_count(num_actions) * strategy_bytes() : 0);
+        }
+        inline std::byte* regret_values(std::byte* data, int n) const { return data + regret_offset(n); }
+        inline const std::byte* regret_values(const std::byte* data, int n) const { return data + regret_offset(n); }
+        // Веса стратегии; nullptr — у записи еще нет блока (lazy_strategies).
+        inline std::byte* strategy_values(std::byte* data, int n) const { return lazy_strategies ? lazy_block(data, n) : data + strategy_offset(n); }
+        inline const std::byte* strategy_values(const std::byte* data, int n) const { return lazy_strategies ? lazy_block(data, n) : data + strategy_offset(n); }
+        inline std::byte* lazy_block(const std::byte* data, int n) const {
+            std::byte* block;
+            std::memcpy(&block, data + strategy_offset(n), sizeof(block));
+            return block;
+        }
+        inline std::byte* prediction_values(std::byte* data, int n) const { return data + prediction_offset(n); }
+        inline const std::byte* prediction_values(const std::byte* data, int n) const { return data + prediction_offset(n); }
+        inline std::byte* baseline_values(std::byte* data, int n) const { return data + baseline_offset(n); }
+        inline const std::byte* baseline_values(const std::byte* data, int n) const { return data + baseline_offset(n); }
+
+        // Плотный массив значений по действиям: у разреженного узла действия под полом получают значение пола.
+        template <typename Load>
+        inline void expand(const std::byte* data, int num_actions, const std::byte* base, double* out, Load&& load_value) const {
+            if (!sparse(num_actions)) {
+                for (int a = 0; a < num_actions; ++a) out[a] = load_value(base, a);
+                return;
+            }
+            std::fill(out, out + num_actions, load_value(base, top_k));
+            for (int j = 0; j < top_k; ++j) out[action_of(data, j)] = load_value(base, j);
+        }
+
+        inline double regret(const std::byte* base, int i) const {
+            switch (storage) {
+                case STORAGE_DOUBLE: return load<double>(base, i);
+                case STORAGE_FLOAT: return load<float>(base, i);
+                default: return load<int32_t>(base, i) / regret_scale;
+            }
+        }
+
+        inline double strategy(const std::byte* base, int i) const {
+            return storage == STORAGE_DOUBLE ? load<double>(base, i) : load<float>(base, i);
+        }
+
+        inline void set_regret(std::byte* base, int i, double value) const {
+            if (regret_plus && value < 0) value = 0;
+            switch (storage) {
+                case STORAGE_DOUBLE: store<double>(base, i, value); break;
+                case STORAGE_FLOAT: store<float>(base, i, (float)value); break;
+                default: store<int32_t>(base, i, scaled_regret(value * regret_scale)); break;
+            }
+        }
+
+        inline void set_strategy(std::byte* base, int i, double value) const {
+            if (storage == STORAGE_DOUBLE) store<double>(base, i, value);
+            else store<float>(base, i, (float)value);
+        }
+
+        inline void add_regret(std::byte* base, int i, double delta) const {
+            if (storage == STORAGE_INT32) store<int32_t>(base, i, scaled_regret(load<int32_t>(base, i) + delta * regret_scale));
+            else set_regret(base, i, regret(base, i) + delta);
+        }
+
+        inline int32_t scaled_regret(double scaled) const {
+            const double floor = regret_plus ? 0.0 : regret_floor * regret_scale;
+            const double ceiling = (double)std::numeric_limits<int32_t>::max();
+            return (int32_t)std::llround(std::min(ceiling, std::max(floor, scaled)));
+        }
+
+        // memcpy: значения не обязаны быть выровнены (float после нечетного числа сожалений и т.п.).
+        template <typename T>
+        static inline T load(const std::byte* base, int i) {
+            T value;
+            std::memcpy(&value, base + (size_t)i * sizeof(T), sizeof(T));
+            return value;
+        }
+
+        template <typename T>
+        static inline void store(std::byte* base, int i, T value) {
+            std::memcpy(base + (size_t)i * sizeof(T), &value, sizeof(T));
+        }
+    };
+
+    // Запись узла в слябе шарда: заголовок, ключ (до кратного 8) и накопители в кодировке
+    // таблицы (NodeEncoding) одним куском. Записи не перемещаются до очистки таблицы, поэтому
+    // указатели на них (в журналах) остаются валидными.
+    struct Node {
+        int32_t num_actions;
+        uint32_t key_length;
+
+        inline std::string_view key() const { return {reinterpret_cast<const char*>(this + 1), key_length}; }
+        inline std::byte* bytes() { return reinterpret_cast<std::byte*>(this + 1) + padded(key_length); }
+        inline const std::byte* bytes() const { return reinterpret_cast<const std::byte*>(this + 1) + padded(key_length); }
+
+        static inline size_t padded(size_t n) { return (n + 7) & ~(size_t)7; }
+        static inline size_t record_bytes(size_t key_length, size_t value_bytes) {
+            return sizeof(Node) + padded(key_length) + padded(value_bytes);
+        }
+    };
+
+    // Что несет запись журнала (при поочередных обновлениях узел получает только одну половину).
+    enum UpdateKind : uint8_t {
+        UPDATE_BOTH = 0,        // num_actions сожалений, затем num_actions весов стратегии
+        UPDATE_REGRETS = 1,     // только num_actions сожалений
+        UPDATE_STRATEGY = 2     // только num_actions весов стратегии
+    };
+
+    // Запись журнала: узел найден при чтении сожалений, поэтому слияние идет без поиска по ключу.
+    // Значения лежат в общем массиве журнала (см. UpdateKind).
+    struct UpdateRecord {
+        uint64_t key_hash;
+        Node* node;
+        size_t offset;
+        int num_actions;
+        UpdateKind kind;
+
+        inline size_t value_count() const { return (kind == UPDATE_BOTH ? 2 : 1) * (size_t)num_actions; }
+    };
+
+    // Плоский журнал обновлений потока; копится между итерациями до слияния в NodeTable.
+    class UpdateLog {
+    public:
+        inline double* append(uint64_t key_hash, Node* node, int num_actions, UpdateKind kind = UPDATE_BOTH) {
+            const size_t offset = values_.size();
+            const UpdateRecord record{key_hash, node, offset, num_actions, kind};
+            grow(records_, records_.size() + 1);
+            grow(values_, offset + record.value_count());
+            records_.push_back(record);
+            values_.resize(offset + record.value_count());
+            return values_.data() + offset;
+        }
+
+        inline void clear() { records_.clear(); values_.clear(); }
+        inline bool empty() const { return records_.empty(); }
+        // Размер журнала в значениях double — по нему решается, пора ли сливать.
+        inline size_t value_count() const { return values_.size(); }
+        inline std::vector<UpdateRecord>& records() { return records_; }
+        inline const double* values() const { return values_.data(); }
+        // Сколько раз журнал увеличивал свои буферы (обращения к куче); после прогрева не растет.
+        inline long long growths() const { return growths_; }
+
+        inline void swap(UpdateLog& other) {
+            records_.swap(other.records_);
+            values_.swap(other.values_);
+        }
+
+    private:
+        template <typename T>
+        inline void grow(std::vector<T>& v, size_t needed) {
+            if (needed <= v.capacity()) return;
+            v.reserve(std::max(needed, 2 * v.capacity()));
+            growths_++;
+        }
+
+        std::vector<UpdateRecord> records_;
+        std::vector<double> values_;
+        long long growths_ = 0;
+    };
+
+    // Таблица узлов, разбитая на шарды по старшим битам хеша ключа: у каждого шарда своя блокировка,
+    // поэтому потоки, читающие и сливающие разные узлы, не ждут друг друга.
+    //
+    // Шард — открытый индекс (хеш ключа -> запись) с линейным пробированием и слябы с записями узлов
+    // (SlabArena): ключ и накопители лежат подряд за заголовком, так что поиск касается ячейки
+    // индекса и начала записи, а накладные расходы на узел — 16 байт ячейки и 8 байт заголовка.
+    // Хеш считается один раз при обходе, а ячейку индекса можно заранее подтянуть в кэш через
+    // prefetch(), не зная ничего, кроме хеша.
+    //
+    // При materialize_visits > 1 узел создается не при первом чтении: до materialize_visits-го
+    // посещения ячейка индекса хранит только счетчик посещений (без ключа — совпадение 64-битных
+    // хешей разных ключей пренебрежимо редко), чтение отдает нулевые сожаления (равномерную
+    // стратегию), а обновления таких посещений отбрасываются. Большинство глубоких узлов в
+    // выборочном обучении посещаются один раз и так и не занимают места под запись.
+    //
+    // В режиме NUMA_LOCAL шард s принадлежит узлу NUMA s % N: его слябы лежат в памяти
+    // этого узла, а обновления чужих шардов при слиянии не пишутся через межсокетную шину,
+    // а откладываются в почтовый ящик узла-владельца и применяются его потоками.
+    class NodeTable {
+    public:
+        static constexpr int SHARD_BITS = 6;
+        static constexpr int NUM_SHARDS = 1 << SHARD_BITS;
+
+        NodeTable() {
+            for (Shard& shard : shards_) shard.reset(std::make_unique<SlabArena>());
+        }
+
+        static inline uint64_t hash_key(std::string_view key) { return std::hash<std::string_view>{}(key); }
+        static inline int shard_of(uint64_t key_hash) { return (int)(key_hash >> (64 - SHARD_BITS)); }
+
+        // Размещение слябов: по узлам NUMA и/или на больших страницах. Существующие узлы переносятся
+        // в новую память, поэтому вызывать только между обучениями (журналы потоков пусты).
+        inline void configure_memory(NumaMode mode, const NumaTopology& topology, bool huge_pages) {
+            auto locks = lock_all();
+            settle();
+            const int num_nodes = std::max(1, topology.num_nodes());
+            numa_mode_ = mode;
+            huge_pages_ = huge_pages;
+            for (int s = 0; s < NUM_SHARDS; ++s) {
+                Shard& shard = shards_[s];
+                shard.owner = mode == NUMA_LOCAL ? s % num_nodes : 0;
+                shard.numa_nodes.clear();
+                if (mode == NUMA_LOCAL) shard.numa_nodes = {topology.node_ids[shard.owner]};
+                else if (mode == NUMA_INTERLEAVE) shard.numa_nodes = topology.node_ids;
+                rebuild(shard, make_arena(shard), encoding_);
+            }
+            num_owners_ = mode == NUMA_LOCAL ? num_nodes : 1;
+            mailboxes_ = std::vector<Mailbox>(num_owners_);
+        }
+
+        // Сколько кусков памяти ядро отказалось привязать к узлам NUMA (0 — размещение выполнено).
+        inline int numa_bind_failures() const {
+            auto locks = lock_all();
+            int failures = 0;
+            for (const Shard& shard : shards_) failures += shard.arena->bind_failures();
+            return failures;
+        }
+
+        // Память таблицы: байт занято записями и индексами и байт взято у системы.
+        inline size_t used_bytes() const {
+            auto locks = lock_all();
+            size_t total = 0;
+            for (const Shard& shard : shards_) total += shard.arena->used_bytes();
+            return total;
+        }
+
+        inline size_t mapped_bytes() const {
+            auto locks = lock_all();
+            size_t total = 0;
+            for (const Shard& shard : shards_) total += shard.arena->mapped_bytes();
+            return total;
+        }
+
+        // Посещение, на котором узел получает запись (1 — сразу). Уже созданные узлы не меняются.
+        inline void configure_materialization(int visits) {
+            auto locks = lock_all();
+            materialize_visits_ = std::max(1, visits);
+        }
+
+        // Находит (или создает) узел и копирует его текущие сожаления в out (с прогнозом, если
+        // кодировка его хранит, — по ним строится стратегия). nullptr — узел еще
+        // не создан (см. materialize_visits): в out нули, обновления этого посещения не нужны.
+        inline Node* load_regrets(std::string_view key, uint64_t key_hash, int num_actions, double* out) {
+            Shard& shard = shards_[shard_of(key_hash)];
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            Slot* slot = shard.find(key, key_hash);
+            const uint32_t visits = !slot ? 1 : slot->is_counter() ? slot->visits() + 1 : 0;
+            if (visits && (int)visits < materialize_visits_) {
+                if (slot) slot->node = Slot::counter(visits);
+                else shard.add_counter(key_hash, visits);
+                std::fill(out, out + num_actions, 0.0);
+                return nullptr;
+            }
+            Node* node = !slot ? shard.add(key, key_hash, num_actions, encoding_) : slot->node;
+            if (visits > 1 || node->num_actions != num_actions) node = shard.replace(*slot, key, num_actions, encoding_);
+            catch_up(node);
+            encoding_.predicted_regrets(node->bytes(), num_actions, out);
+            return node;
+        }
+
+        // Подсказка процессору загрузить ячейку индекса для ключа с этим хешем. Без блокировки:
+        // адрес может оказаться устаревшим (индекс вырос), но prefetch не обращается к памяти
+        // по-настоящему и не падает на недействительном адресе.
+        inline void prefetch(uint64_t key_hash) const {
+            const Shard& shard = shards_[shard_of(key_hash)];
+            const Slot* slots = shard.slots_view.load(std::memory_order_relaxed);
+            const size_t mask = shard.mask_view.load(std::memory_order_relaxed);
+            if (slots) __builtin_prefetch(slots + (key_hash & mask));
+        }
+
+        // Слияние журнала: записи сортируются по шарду (внутри — по узлу), и каждый шард
+        // блокируется один раз на всю свою пачку. Если задан local_node (индекс узла NUMA
+        // текущего потока) и включено размещение NUMA_LOCAL, записи чужих шардов уходят в почтовые
+        // ящики владельцев, а свой ящик сразу разбирается. Журнал после слияния пуст.
+        inline void merge(UpdateLog& log, int local_node = -1) {
+            if (num_owners_ == 1 || local_node < 0 || local_node >= num_owners_) {
+                apply(log);
+                return;
+            }
+
+            auto& records = log.records();
+            std::sort(records.begin(), records.end(), [this](const UpdateRecord& a, const UpdateRecord& b) {
+                int oa = owner_of(a.key_hash), ob = owner_of(b.key_hash);
+                return oa != ob ? oa < ob : record_less(a, b);
+            });
+            const double* values = log.values();
+            size_t i = 0;
+            while (i < records.size()) {
+                const int owner = owner_of(records[i].key_hash);
+                size_t end = i;
+                while (end < records.size() && owner_of(records[end].key_hash) == owner) end++;
+                if (owner == local_node) apply_sorted(records, values, i, end);
+                else {
+                    Mailbox& box = mailboxes_[owner];
+                    std::lock_guard<std::mutex> lock(box.mutex);
+                    for (size_t r = i; r < end; ++r) {
+                        const UpdateRecord& rec = records[r];
+                        double* dst = box.log.append(rec.key_hash, rec.node, rec.num_actions, rec.kind);
+                        std::copy(values + rec.offset, values + rec.offset + rec.value_count(), dst);
+                    }
+                }
+                i = end;
+            }
+            log.clear();
+            drain_mailbox(local_node);
+        }
+
+        // Применяет обновления, отложенные для узла NUMA node другими сокетами.
+        inline void drain_mailbox(int node) {
+            if (node < 0 || node >= (int)mailboxes_.size()) return;
+            thread_local UpdateLog inbox;
+            {
+                Mailbox& box = mailboxes_[node];
+                std::lock_guard<std::mutex> lock(box.mutex);
+                if (box.log.empty()) return;
+                inbox.swap(box.log);
+            }
+            apply(inbox);
+        }
+
+        inline bool routes_updates() const { return num_owners_ > 1; }
+
+        inline size_t size() const {
+            size_t total = 0;
+            for (const Shard& shard : shards_) {
+                std::lock_guard<std::mutex> lock(shard.mutex);
+                total += shard.size - shard.counters;
+            }
+            return total;
+        }
+
+        // Дисконтирование всех узлов (см. NodeEncoding::discount). Только между обучениями.
+        // С эпохами в кодировке (NodeEncoding::epochs) таблица не проходится: вызов открывает новую
+        // эпоху и дописывает логарифмы множителей в накопленные суммы, а узел догоняет пропущенные
+        // эпохи одним умножением при следующем чтении, слиянии или обходе for_each (catch_up).
+        // Знак сожаления между эпохами не меняется, так что произведение множителей — то же
+        // дисконтирование; в STORAGE_INT32 округление одно вместо одного на эпоху.
+        inline void discount(double positive, double negative, double strategy_factor) {
+            auto locks = lock_all();
+            if (encoding_.epochs) {
+                if (discount_sums_.size() > MAX_DISCOUNT_EPOCHS) settle();
+                const DiscountSums& last = discount_sums_.back();
+                discount_sums_.push_back({last.positive + std::log(positive), last.negative + std::log(negative),
+                                          last.strategy + std::log(strategy_factor)});
+                for (Shard& shard : shards_) shard.epoch = (uint32_t)discount_sums_.size() - 1;
+                return;
+            }
+            for (Shard& shard : shards_) {
+                for (size_t i = 0; i < shard.slot_count; ++i) {
+                    const Slot& slot = shard.slots[i];
+                    if (slot.node && !slot.is_counter()) encoding_.discount(slot.node->bytes(), slot.node->num_actions, positive, negative, strategy_factor);
+                }
+            }
+        }
+
+        // Узлы, для которых пока есть только счетчик посещений.
+        inline size_t counter_count() const {
+            size_t total = 0;
+            for (const Shard& shard : shards_) {
+                std::lock_guard<std::mutex> lock(shard.mutex);
+                total += shard.counters;
+            }
+            return total;
+        }
+
+        // Обход всех узлов под блокировкой всех шардов (сохранение стратегии); узлы перед этим
+        // догоняют дисконтирование — значения те же, что при проходе по таблице.
+        template <typename F>
+        inline void for_each(F&& f) const {
+            auto locks = lock_all();
+            for (const Shard& shard : shards_) {
+                for (size_t i = 0; i < shard.slot_count; ++i) {
+                    const Slot& slot = shard.slots[i];
+                    if (!slot.node || slot.is_counter()) continue;
+                    catch_up(slot.node);
+                    f(slot.node->key(), *slot.node);
+                }
+            }
+        }
+
+        inline void clear() {
+            auto locks = lock_all();
+            for (Shard& shard : shards_) shard.reset(make_arena(shard));
+            discount_sums_.assign(1, DiscountSums{});
+        }
+
+        // Узел со значениями накопителей (загрузка стратегии); кодируются в кодировку таблицы.
+        inline void insert(std::string_view key, int num_actions, const double* regrets, const double* strategy,
+                           const double* predictions = nullptr, const double* baselines = nullptr) {
+            const uint64_t key_hash = hash_key(key);
+            Shard& shard = shards_[shard_of(key_hash)];
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            Slot* slot = shard.find(key, key_hash);
+            Node* node = slot ? shard.replace(*slot, key, num_actions, encoding_) : shard.add(key, key_hash, num_actions, encoding_);
+            ensure_strategies(shard, node, strategy);
+            encoding_.assign(node->bytes(), num_actions, regrets, strategy, predictions, baselines);
+        }
+
+        inline const NodeEncoding& encoding() const { return encoding_; }
+
+        // Смена кодировки накопителей; узлы перекодируются в новые слябы. Только между обучениями.
+        inline void configure_encoding(const NodeEncoding& encoding) {
+            auto locks = lock_all();
+            settle();
+            const NodeEncoding old = encoding_;
+            encoding_ = encoding;
+            for (Shard& shard : shards_) rebuild(shard, make_arena(shard), old);
+        }
+
+    private:
+        // Ячейка индекса (16 байт, четыре на строку кэша); пустая — node == nullptr.
+        // Ячейка-счетчик вместо указателя хранит (visits << 1) | 1: записи выровнены на 8.
+        struct Slot {
+            uint64_t hash;
+            Node* node;
+
+            inline bool is_counter() const { return reinterpret_cast<uintptr_t>(node) & 1; }
+            inline uint32_t visits() const { return (uint32_t)(reinterpret_cast<uintptr_t>(node) >> 1); }
+            static inline Node* counter(uint32_t visits) { return reinterpret_cast<Node*>(((uintptr_t)visits << 1) | 1); }
+        };
+
+        struct alignas(64) Shard {
+            mutable std::mutex mutex;
+            std::unique_ptr<SlabArena> arena;
+            // Индекс в слябах шарда; размер — степень двойки, заполнение не выше половины.
+            // Старые массивы индекса после роста остаются в арене (в сумме не больше текущего).
+            Slot* slots = nullptr;
+            size_t slot_count = 0;
+            // Занятые ячейки, из них счетчики посещений.
+            size_t size = 0;
+            size_t counters = 0;
+            // Копии адреса и маски индекса для prefetch без блокировки.
+            std::atomic<const Slot*> slots_view{nullptr};
+            std::atomic<size_t> mask_view{0};
+            int owner = 0;
+            // Текущая эпоха дисконтирования: с ней создаются новые записи.
+            uint32_t epoch = 0;
+            // Узлы NUMA, к которым привязаны слябы шарда (пусто — без привязки).
+            std::vector<int> numa_nodes;
+
+            // Пустой шард на новой арене; прежняя арена со всеми записями освобождается.
+            inline void reset(std::unique_ptr<SlabArena> new_arena, size_t capacity = 64) {
+                slots_view.store(nullptr, std::memory_order_relaxed);
+                slots = nullptr;
+                slot_count = 0;
+                size = 0;
+                counters = 0;
+                arena = std::move(new_arena);
+                grow(capacity);
+            }
+
+            inline Slot* find(std::string_view key, uint64_t key_hash) const {
+                const size_t mask = slot_count - 1;
+                for (size_t i = key_hash & mask;; i = (i + 1) & mask) {
+                    Slot& slot = slots[i];
+                    if (!slot.node) return nullptr;
+                    if (slot.hash == key_hash && (slot.is_counter() || slot.node->key() == key)) return &slot;
+                }
+            }
+
+            inline Node* add(std::string_view key, uint64_t key_hash, int num_actions, const NodeEncoding& encoding) {
+                Node* node = make_record(key, num_actions, encoding);
+                if (2 * (size + 1) > slot_count) grow(2 * slot_count);
+                place({key_hash, node});
+                size++;
+                return node;
+            }
+
+            inline void add_counter(uint64_t key_hash, uint32_t visits) {
+                if (2 * (size + 1) > slot_count) grow(2 * slot_count);
+                place({key_hash, Slot::counter(visits)});
+                size++;
+                counters++;
+            }
+
+            // Новая обнуленная запись в ячейке: узел сменил число действий (журналы, еще держащие
+            // старую запись, пишут в нее без вреда — память арены не освобождается) или счетчик
+            // посещений дошел до materialize_visits.
+            inline Node* replace(Slot& slot, std::string_view key, int num_actions, const NodeEncoding& encoding) {
+                if (slot.is_counter()) counters--;
+                slot.node = make_record(key, num_actions, encoding);
+                return slot.node;
+            }
+
+            inline Node* make_record(std::string_view key, int num_actions, const NodeEncoding& encoding) {
+                const size_t value_bytes = encoding.node_bytes(num_actions);
+                void* memory = arena->allocate(Node::record_bytes(key.size(), value_bytes), alignof(uint64_t));
+                Node* node = new (memory) Node{num_actions, (uint32_t)key.size()};
+                std::memcpy(node + 1, key.data(), key.size());
+                encoding.init(node->bytes(), num_actions);
+                if (encoding.epochs) encoding.set_epoch(node->bytes(), num_actions, epoch);
+                return node;
+            }
+
+            inline void attach_strategies(Node* node, const NodeEncoding& encoding) {
+                void* block = arena->allocate(Node::padded(encoding.strategy_block_bytes(node->num_actions)), alignof(uint64_t));
+                encoding.attach_strategies(node->bytes(), node->num_actions, static_cast<std::byte*>(block));
+            }
+
+            inline void grow(size_t capacity) {
+                Slot* old = slots;
+                const size_t old_count = slot_count;
+                slots = static_cast<Slot*>(arena->allocate(capacity * sizeof(Slot), alignof(Slot)));
+                std::fill(slots, slots + capacity, Slot{0, nullptr});
+                slot_count = capacity;
+                for (size_t i = 0; i < old_count; ++i) if (old[i].node) place(old[i]);
+                slots_view.store(slots, std::memory_order_relaxed);
+                mask_view.store(slot_count - 1, std::memory_order_relaxed);
+            }
+
+            inline void place(const Slot& slot) {
+                const size_t mask = slot_count - 1;
+                size_t i = slot.hash & mask;
+                while (slots[i].node) i = (i + 1) & mask;
+                slots[i] = slot;
+            }
+        };
+
+        struct Mailbox {
+            std::mutex mutex;
+            UpdateLog log;
+        };
+
+        inline std::unique_ptr<SlabArena> make_arena(const Shard& shard) const {
+            return std::make_unique<SlabArena>(numa_mode_, shard.numa_nodes, huge_pages_);
+        }
+
+        // Переносит узлы шарда на новую арену, перекодируя накопители из from в текущую кодировку.
+        inline void rebuild(Shard& shard, std::unique_ptr<SlabArena> arena, const NodeEncoding& from) {
+            Slot* old_slots = shard.slots;
+            const size_t old_count = shard.slot_count;
+            std::unique_ptr<SlabArena> old_arena = std::move(shard.arena);
+            size_t capacity = 64;
+            while (capacity < 2 * shard.size) capacity *= 2;
+            shard.reset(std::move(arena), capacity);
+            std::vector<double> regrets, strategy, predictions, baselines;
+            for (size_t i = 0; i < old_count; ++i) {
+                const Node* old = old_slots[i].node;
+                if (!old) continue;
+                if (old_slots[i].is_counter()) {
+                    shard.add_counter(old_slots[i].hash, old_slots[i].visits());
+                    continue;
+                }
+                const int n = old->num_actions;
+                Node* node = shard.add(old->key(), old_slots[i].hash, n, encoding_);
+                regrets.resize(n);
+                strategy.resize(n);
+                predictions.resize(n);
+                baselines.resize(n);
+                from.regrets(old->bytes(), n, regrets.data());
+                from.strategies(old->bytes(), n, strategy.data());
+                from.predictions(old->bytes(), n, predictions.data());
+                from.action_baselines(old->bytes(), n, baselines.data());
+                ensure_strategies(shard, node, strategy.data());
+                encoding_.assign(node->bytes(), n, regrets.data(), strategy.data(), predictions.data(), baselines.data());
+            }
+        }
+
+        // Узел догоняет дисконтирование эпох, прошедших с его последнего обновления (см. discount).
+        // Под блокировкой его шарда; const — значения узла для читателя не меняются.
+        inline void catch_up(Node* node) const {
+            if (!encoding_.epochs) return;
+            const int n = node->num_actions;
+            const uint32_t current = (uint32_t)discount_sums_.size() - 1;
+            const uint32_t epoch = encoding_.epoch(node->bytes(), n);
+            if (epoch == current) return;
+            const DiscountSums& now = discount_sums_.back();
+            const DiscountSums& then = discount_sums_[epoch];
+            encoding_.discount(node->bytes(), n, std::exp(now.positive - then.positive), std::exp(now.negative - then.negative),
+                               std::exp(now.strategy - then.strategy));
+            encoding_.set_epoch(node->bytes(), n, current);
+        }
+
+        // Все узлы догоняют дисконтирование, их эпохи и суммы множителей начинаются заново.
+        // Под блокировкой всех шардов: перед перекодированием и когда сумм накопилось слишком много.
+        inline void settle() {
+            if (encoding_.epochs) {
+                for (Shard& shard : shards_) {
+                    for (size_t i = 0; i < shard.slot_count; ++i) {
+                        const Slot& slot = shard.slots[i];
+                        if (!slot.node || slot.is_counter()) continue;
+                        catch_up(slot.node);
+                        encoding_.set_epoch(slot.node->bytes(), slot.node->num_actions, 0);
+                    }
+                }
+            }
+            discount_sums_.assign(1, DiscountSums{});
+            for (Shard& shard : shards_) shard.epoch = 0;
+        }
+
+        // Узлу без блока весов стратегии (NodeEncoding::lazy_strategies) блок выделяется
+        // перед записью первых ненулевых весов; блок лежит в той же арене шарда.
+        inline void ensure_strategies(Shard& shard, Node* node, const double* strategy) const {
+            if (encoding_.has_strategies(node->bytes(), node->num_actions)) return;
+            if (std::any_of(strategy, strategy + node->num_actions, [](double v) { return v != 0.0; })) shard.attach_strategies(node, encoding_);
+        }
+
+        inline int owner_of(uint64_t key_hash) const { return shards_[shard_of(key_hash)].owner; }
+
+        static inline bool record_less(const UpdateRecord& a, const UpdateRecord& b) {
+            int sa = shard_of(a.key_hash), sb = shard_of(b.key_hash);
+            return sa != sb ? sa < sb : std::less<Node*>()(a.node, b.node);
+        }
+
+        inline void apply(UpdateLog& log) {
+            auto& records = log.records();
+            std::sort(records.begin(), records.end(), record_less);
+            apply_sorted(records, log.values(), 0, records.size());
+            log.clear();
+        }
+
+        // Записи [begin, end) отсортированы по шарду: каждый шард блокируется один раз.
+        // Записи одного узла идут подряд: с первой из них, несущей сожаления, прогноз узла
+        // начинается заново. Недостающая половина записи (UpdateKind) прибавляется нулями.
+        inline void apply_sorted(const std::vector<UpdateRecord>& records, const double* values, size_t begin, size_t end) {
+            thread_local std::vector<double> zeros;
+            const Node* restarted = nullptr;
+            size_t i = begin;
+            while (i < end) {
+                const int s = shard_of(records[i].key_hash);
+                std::lock_guard<std::mutex> lock(shards_[s].mutex);
+                for (; i < end && shard_of(records[i].key_hash) == s; ++i) {
+                    const UpdateRecord& r = records[i];
+                    Node* node = r.node;
+                    if (node->num_actions != r.num_actions) {
+                        Slot* slot = shards_[s].find(node->key(), r.key_hash);
+                        node = slot->node->num_actions == r.num_actions ? slot->node : shards_[s].replace(*slot, node->key(), r.num_actions, encoding_);
+                    }
+                    catch_up(node);
+                    if (r.kind != UPDATE_BOTH && zeros.size() < (size_t)r.num_actions) zeros.resize(r.num_actions, 0.0);
+                    const double* regret = r.kind == UPDATE_STRATEGY ? zeros.data() : values + r.offset;
+                    const double* strategy = r.kind == UPDATE_REGRETS ? zeros.data() : r.kind == UPDATE_STRATEGY ? values + r.offset : regret + r.num_actions;
+                    const bool first = r.kind != UPDATE_STRATEGY && restarted != r.node;
+                    if (first) restarted = r.node;
+                    ensure_strategies(shards_[s], node, strategy);
+                    encoding_.add(node->bytes(), r.num_actions, regret, strategy, first);
+                }
+            }
+        }
+
+        inline std::vector<std::unique_lock<std::mutex>> lock_all() const {
+            std::vector<std::unique_lock<std::mutex>> locks;
+            locks.reserve(NUM_SHARDS);
+            for (const Shard& shard : shards_) locks.emplace_back(shard.mutex);
+            return locks;
+        }
+
+        // Суммы логарифмов множителей дисконтирования (положительные и отрицательные сожаления,
+        // веса стратегии) за эпохи до i; последняя — текущая эпоха.
+        struct DiscountSums {
+            double positive = 0.0;
+            double negative = 0.0;
+            double strategy = 0.0;
+        };
+        // Предел длины сумм (24 байта на эпоху): дальше все узлы догоняются разом (settle).
+        static constexpr size_t MAX_DISCOUNT_EPOCHS = 1 << 16;
+
+        std::array<Shard, NUM_SHARDS> shards_;
+        NodeEncoding encoding_;
+        std::vector<DiscountSums> discount_sums_ = std::vector<DiscountSums>(1);
+        NumaMode numa_mode_ = NUMA_OFF;
+        bool huge_pages_ = false;
+        int materialize_visits_ = 1;
+        int num_owners_ = 1;
+        std::vector<Mailbox> mailboxes_ = std::vector<Mailbox>(1);
+    };
+
+    // Узлы верхних уровней дерева (SolverConfig::hot_depth) читаются и обновляются каждым потоком
+    // на каждой итерации: даже в шардах их блокировки и строки кэша ходят между ядрами. Поток
+    // держит для них свой снимок сожалений и локальные приращения, а в таблицу они уходят раз
+    // в reduce() через журнал. Снимок обновляется из таблицы при первом чтении после reduce().
+    // Поток и так не видит своих обновлений до слияния журнала, так что устаревание снимка
+    // того же порядка. Указатели Entry стабильны до clear().
+    class HotNodeCache {
+    public:
+        struct Entry {
+            std::string key;
+            Node* node = nullptr;
+            int num_actions = 0;
+            bool fresh = false;
+            bool dirty = false;
+            // Снимок сожалений, приращения сожалений и весов стратегии — по num_actions значений.
+            std::vector<double> values;
+
+            inline double* snapshot() { return values.data(); }
+            inline double* regret_delta() { return values.data() + num_actions; }
+            inline double* strategy_delta() { return values.data() + 2 * (size_t)num_actions; }
+        };
+
+        // Копирует сожаления узла в out (из снимка потока); nullptr — узел не кэшируется
+        // (совпал хеш другого ключа или сменилось число действий), читать его надо из таблицы.
+        inline Entry* load(NodeTable& table, std::string_view key, uint64_t key_hash, int num_actions, double* out) {
+            Entry& entry = entries_[key_hash];
+            if (!entry.num_actions) {
+                entry.key.assign(key.data(), key.size());
+                entry.num_actions = num_actions;
+                entry.values.assign(3 * (size_t)num_actions, 0.0);
+            } else if (entry.key != key || entry.num_actions != num_actions) {
+                return nullptr;
+            }
+            // Пока узел не создан (materialize_visits), каждое посещение идет в таблицу и считается.
+            if (!entry.fresh || !entry.node) {
+                entry.node = table.load_regrets(key, key_hash, num_actions, entry.snapshot());
+                entry.fresh = true;
+            }
+            std::copy(entry.snapshot(), entry.snapshot() + num_actions, out);
+            return &entry;
+        }
+
+        // Переносит накопленные приращения в журнал потока; снимки перечитываются при следующем load.
+        inline void reduce(UpdateLog& log) {
+            for (auto& item : entries_) {
+                Entry& entry = item.second;
+                entry.fresh = false;
+                if (!entry.dirty) continue;
+                double* out = log.append(item.first, entry.node, entry.num_actions);
+                std::copy(entry.regret_delta(), entry.regret_delta() + 2 * (size_t)entry.num_actions, out);
+                std::fill(entry.regret_delta(), entry.regret_delta() + 2 * (size_t)entry.num_actions, 0.0);
+                entry.dirty = false;
+            }
+        }
+
+        // Забывает узлы (после reduce): кэш общий для решателей потока и не должен держать чужие записи.
+        inline void clear() { entries_.clear(); }
+        inline size_t size() const { return entries_.size(); }
+
+    private:
+        std::unordered_map<uint64_t, Entry> entries_;
+    };
+}
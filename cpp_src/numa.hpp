@@ -0,0 +1,92 @@
+// mccfr_ofc-main/cpp_src/numa.hpp
+
+#pragma once
+#include <vector>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <cstdint>
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace ofc {
+
+    enum NumaMode {
+        NUMA_OFF = 0,         // обычная куча: память узла берет поток, вставивший его первым
+        NUMA_LOCAL = 1,       // шард таблицы привязан к своему сокету, обновления идут владельцу
+        NUMA_INTERLEAVE = 2   // страницы таблицы чередуются по всем сокетам (базовая линия бенчмарка)
+    };
+
+    // "0-3,8-11" -> {0,1,2,3,8,9,10,11}
+    inline std::vector<int> parse_cpu_list(const std::string& text) {
+        std::vector<int> cpus;
+        std::stringstream ss(text);
+        std::string part;
+        while (std::getline(ss, part, ',')) {
+            if (part.empty() || part == "\n") continue;
+            size_t dash = part.find('-');
+            int first = std::stoi(part.substr(0, dash));
+            int last = dash == std::string::npos ? first : std::stoi(part.substr(dash + 1));
+            for (int c = first; c <= last; ++c) cpus.push_back(c);
+        }
+        return cpus;
+    }
+
+    // Узлы NUMA с процессорами (по /sys без libnuma). Без NUMA — один узел 0 со всеми CPU.
+    struct NumaTopology {
+        std::vector<int> node_ids;
+        std::vector<std::vector<int>> node_cpus;
+
+        inline int num_nodes() const { return (int)node_ids.size(); }
+
+        static inline NumaTopology detect() {
+            NumaTopology topology;
+            std::ifstream online("/sys/devices/system/node/online");
+            std::string line;
+            if (online && std::getline(online, line)) {
+                for (int node : parse_cpu_list(line)) {
+                    std::ifstream cpulist("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+                    std::string cpus_line;
+                    if (!cpulist || !std::getline(cpulist, cpus_line)) continue;
+                    std::vector<int> cpus = parse_cpu_list(cpus_line);
+                    if (cpus.empty()) continue;  // узлы только с памятью
+                    topology.node_ids.push_back(node);
+                    topology.node_cpus.push_back(std::move(cpus));
+                }
+            }
+            if (topology.node_ids.empty()) {
+                topology.node_ids.push_back(0);
+                topology.node_cpus.emplace_back();
+            }
+            return topology;
+        }
+    };
+
+    // Индекс узла NUMA (в NumaTopology), за которым закреплен текущий поток; -1 — не закреплен.
+    inline int& current_numa_node() {
+        thread_local int node = -1;
+        return node;
+    }
+
+    // Политика размещения страниц через системный вызов mbind (без libnuma).
+    inline bool bind_memory(void* addr, size_t len, NumaMode mode, const std::vector<int>& node_ids) {
+#if defined(__linux__) && defined(SYS_mbind)
+        constexpr int MPOL_BIND_POLICY = 2;
+        constexpr int MPOL_INTERLEAVE_POLICY = 3;
+        constexpr size_t MASK_WORDS = 16;
+        unsigned long mask[MASK_WORDS] = {0};
+        for (int id : node_ids) {
+            if (id < 0 || id >= (int)(MASK_WORDS * 64)) return false;
+            mask[id / 64] |= 1ul << (id % 64);
+        }
+        int policy = mode == NUMA_INTERLEAVE ? MPOL_INTERLEAVE_POLICY : MPOL_BIND_POLICY;
+        return syscall(SYS_mbind, addr, len, policy, mask, MASK_WORDS * 64, 0) == 0;
+#else
+        (void)addr; (void)len; (void)mode; (void)node_ids;
+        return false;
+#endif
+    }
+}
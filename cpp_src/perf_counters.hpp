@@ -0,0 +1,69 @@
+// mccfr_ofc-main/cpp_src/perf_counters.hpp
+
+#pragma once
+#include <cstdint>
+#include <cstring>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace ofc {
+
+    // Аппаратный счетчик промахов кэша последнего уровня для текущего потока (и потоков,
+    // созданных после start) через perf_event_open. Без PMU или при запрете ядром
+    // (kernel.perf_event_paranoid) счетчик недоступен и stop() возвращает -1.
+    class CacheMissCounter {
+    public:
+        CacheMissCounter() {
+#ifdef __linux__
+            perf_event_attr attr;
+            std::memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_CACHE_MISSES;
+            attr.disabled = 1;
+            attr.inherit = 1;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            fd_ = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+#endif
+        }
+
+        ~CacheMissCounter() {
+#ifdef __linux__
+            if (fd_ >= 0) close(fd_);
+#endif
+        }
+
+        CacheMissCounter(const CacheMissCounter&) = delete;
+        CacheMissCounter& operator=(const CacheMissCounter&) = delete;
+
+        inline bool available() const { return fd_ >= 0; }
+
+        inline void start() {
+#ifdef __linux__
+            if (fd_ < 0) return;
+            ioctl(fd_, PERF_EVENT_IOC_RESET, 0);
+            ioctl(fd_, PERF_EVENT_IOC_ENABLE, 0);
+#endif
+        }
+
+        inline long long stop() {
+#ifdef __linux__
+            if (fd_ < 0) return -1;
+            ioctl(fd_, PERF_EVENT_IOC_DISABLE, 0);
+            uint64_t value = 0;
+            if (read(fd_, &value, sizeof(value)) != (ssize_t)sizeof(value)) return -1;
+            return (long long)value;
+#else
+            return -1;
+#endif
+        }
+
+    private:
+        int fd_ = -1;
+    };
+}
@@ -0,0 +1,271 @@
+// mccfr_ofc-main/cpp_src/rollout.hpp
+
+#pragma once
+#include "leaf_estimator.hpp"
+#include <omp/Random.h>
+#include <array>
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <omp.h>
+
+namespace ofc {
+
+    struct RolloutConfig {
+        int min_rollouts = 32;
+        int max_rollouts = 1024;
+        // Остановка, когда стандартная ошибка среднего (в очках) не больше цели; 0 — всегда max_rollouts.
+        double std_error_target = 0.5;
+        // Как часто проверять условие остановки.
+        int check_interval = 16;
+    };
+
+    struct RolloutResult {
+        double mean = 0.0;        // ценность для игрока 0
+        double std_error = 0.0;
+        int rollouts = 0;
+    };
+
+    // Доигрывание обеих досок случайными раздачами из невидимых карт и быстрой эвристической
+    // политикой расстановки; подсчет очков — напрямую по omp без строк и векторов.
+    class RolloutEvaluator : public LeafEstimator {
+    public:
+        RolloutEvaluator(const HandEvaluator& evaluator, const RolloutConfig& config = RolloutConfig())
+            : evaluator_(evaluator), config_(config) {}
+
+        // Листья оцениваются в потоке вызывающего (обучение уже распараллелено по итерациям).
+        void estimate(const std::vector<const GameState*>& states, std::vector<double>& out_values) const override {
+            omp::XoroShiro128Plus& rng = thread_rng();
+            out_values.resize(states.size());
+            for (size_t i = 0; i < states.size(); ++i) out_values[i] = evaluate(*states[i], rng).mean;
+        }
+
+        inline RolloutResult evaluate(const GameState& state, omp::XoroShiro128Plus& rng) const {
+            if (state.is_terminal()) return {state.get_payoffs(evaluator_).first, 0.0, 0};
+            Accumulator acc;
+            while (!acc.should_stop(config_)) {
+                for (int i = 0; i < config_.check_interval && acc.n < config_.max_rollouts; ++i) acc.add(rollout(state, rng));
+            }
+            return acc.result();
+        }
+
+        // Одна позиция на всех потоках (онлайн-игра): общие суммы, остановка по той же цели.
+        inline RolloutResult evaluate_parallel(const GameState& state) const {
+            if (state.is_terminal()) return {state.get_payoffs(evaluator_).first, 0.0, 0};
+            Accumulator shared;
+            std::atomic<bool> done{false};
+            #pragma omp parallel
+            {
+                omp::XoroShiro128Plus& rng = thread_rng();
+                while (!done.load(std::memory_order_relaxed)) {
+                    Accumulator local;
+                    for (int i = 0; i < config_.check_interval; ++i) local.add(rollout(state, rng));
+                    #pragma omp critical(ofc_rollout_merge)
+                    {
+                        if (!done.load(std::memory_order_relaxed)) {
+                            shared.merge(local);
+                            if (shared.should_stop(config_)) done.store(true, std::memory_order_relaxed);
+                        }
+                    }
+                }
+            }
+            return shared.result();
+        }
+
+        // Одно доигрывание до конца раздачи; возвращает очки игрока 0.
+        inline double rollout(const GameState& state, omp::XoroShiro128Plus& rng) const {
+            std::array<Board, 2> boards = {state.get_player_board(0), state.get_player_board(1)};
+            int street = state.get_street();
+            int current = state.get_current_player();
+            const int dealer = state.get_dealer_pos();
+
+            // Невидимые карты: все, кроме выложенных, сброшенных и текущей раздачи.
+            CardMask known = board_mask(boards[0]) | board_mask(boards[1]);
+            for (int p = 0; p < 2; ++p) for (Card c : state.get_discards(p)) known |= card_bit(c);
+            for (Card c : state.get_dealt_cards()) known |= card_bit(c);
+            std::array<Card, 52> pool;
+            int pool_size = 0;
+            for (Card c = 0; c < 52; ++c) if (!(known & card_bit(c))) pool[pool_size++] = c;
+
+            std::array<Card, 5> hand;
+            int hand_size = 0;
+            for (Card c : state.get_dealt_cards()) hand[hand_size++] = c;
+
+            while (street <= 5) {
+                place_cards(boards[current], hand.data(), hand_size, street > 1);
+                if (current == dealer) street++;
+                current = (current + 1) % 2;
+                if (street > 5) break;
+                hand_size = (street == 1) ? 5 : 3;
+                for (int i = 0; i < hand_size; ++i) {
+                    int j = (int)(rng() % (uint64_t)pool_size);
+                    hand[i] = pool[j];
+                    pool[j] = pool[--pool_size];
+                }
+            }
+            return score(boards[0], boards[1]);
+        }
+
+        // Очки игрока 0 по заполненным доскам; совпадает с GameState::get_payoffs.
+        inline double score(const Board& b1, const Board& b2) const {
+            const int SCOOP_BONUS = 3;
+            RowStrengths s1 = row_strengths(b1), s2 = row_strengths(b2);
+            bool f1 = s1.top > s1.mid || s1.mid > s1.bot;
+            bool f2 = s2.top > s2.mid || s2.mid > s2.bot;
+            int r1 = f1 ? 0 : royalty(b1, s1);
+            int r2 = f2 ? 0 : royalty(b2, s2);
+            if (f1 && f2) return 0.0;
+            if (f1) return -(double)(SCOOP_BONUS + r2);
+            if (f2) return (double)(SCOOP_BONUS + r1);
+
+            // Как и в get_payoffs, ничья по линии уходит второму игроку.
+            int line_score = (s1.top > s2.top ? 1 : -1) + (s1.mid > s2.mid ? 1 : -1) + (s1.bot > s2.bot ? 1 : -1);
+            if (std::abs(line_score) == 3) line_score = (line_score > 0) ? SCOOP_BONUS : -SCOOP_BONUS;
+            return line_score + r1 - r2 + fantasyland_bonus(b1, s1) - fantasyland_bonus(b2, s2);
+        }
+
+        const RolloutConfig& get_config() const { return config_; }
+
+    private:
+        struct RowStrengths { int top, mid, bot; };
+
+        struct Accumulator {
+            int n = 0;
+            double sum = 0.0, sum_sq = 0.0;
+            inline void add(double v) { n++; sum += v; sum_sq += v * v; }
+            inline void merge(const Accumulator& o) { n += o.n; sum += o.sum; sum_sq += o.sum_sq; }
+            inline double std_error() const {
+                if (n < 2) return INFINITY;
+                double mean = sum / n;
+                return std::sqrt(std::max(0.0, sum_sq / n - mean * mean) / (n - 1));
+            }
+            inline bool should_stop(const RolloutConfig& c) const {
+                if (n >= c.max_rollouts) return true;
+                return n >= c.min_rollouts && c.std_error_target > 0 && std_error() <= c.std_error_target;
+            }
+            inline RolloutResult result() const { return {n ? sum / n : 0.0, n > 1 ? std_error() : 0.0, n}; }
+        };
+
+        inline RowStrengths row_strengths(const Board& b) const {
+            omp::Hand top = omp::Hand::empty(), mid = omp::Hand::empty(), bot = omp::Hand::empty();
+            for (Card c : b.top) if (c != INVALID_CARD) top += omp::Hand(c);
+            for (Card c : b.middle) if (c != INVALID_CARD) mid += omp::Hand(c);
+            for (Card c : b.bottom) if (c != INVALID_CARD) bot += omp::Hand(c);
+            return {evaluator_.strength(top), evaluator_.strength(mid), evaluator_.strength(bot)};
+        }
+
+        inline int royalty(const Board& b, const RowStrengths& s) const {
+            return evaluator_.get_top_royalty(b.top[0], b.top[1], b.top[2]) +
+                   evaluator_.get_royalty_by_strength(s.mid, true) +
+                   evaluator_.get_royalty_by_strength(s.bot, false);
+        }
+
+        inline double fantasyland_bonus(const Board& b, const RowStrengths& s) const {
+            int cat = s.top >> 12;
+            if (cat == 4) return evaluator_.get_fantasyland_bonus(17);
+            if (cat != 2) return 0.0;
+            int r0 = get_rank(b.top[0]), r1 = get_rank(b.top[1]), r2 = get_rank(b.top[2]);
+            int pair_rank = (r0 == r1 || r0 == r2) ? r0 : r1;
+            return pair_rank >= 10 ? evaluator_.get_fantasyland_bonus(4 + pair_rank) : 0.0; // QQ -> 14 ... AA -> 16
+        }
+
+        // Эвристическая ценность частично заполненной доски для политики доигрывания:
+        // роялти собранных рядов, штраф за нарушенный порядок рядов и легкий перевес силы вниз.
+        inline double placement_value(const Board& b) const {
+            const double FOUL_PENALTY = 30.0;
+            int top_n = 0, mid_n = 0, bot_n = 0;
+            for (Card c : b.top) top_n += c != INVALID_CARD;
+            for (Card c : b.middle) mid_n += c != INVALID_CARD;
+            for (Card c : b.bottom) bot_n += c != INVALID_CARD;
+            RowStrengths s = row_strengths(b);
+
+            double v = evaluator_.get_royalty_by_strength(s.mid, true) + evaluator_.get_royalty_by_strength(s.bot, false);
+            int top_cat = s.top >> 12, mid_cat = s.mid >> 12, bot_cat = s.bot >> 12;
+            if (top_cat >= 2) {
+                // Пара или трипс наверху: роялти по рангу повторяющейся карты.
+                int counts[13] = {0};
+                for (Card c : b.top) if (c != INVALID_CARD) counts[get_rank(c)]++;
+                for (int r = 0; r < 13; ++r) {
+                    if (counts[r] == 3) v += 10 + r;
+                    else if (counts[r] == 2 && r >= 4) v += r - 3;
+                }
+            }
+            if (top_n == 3 && mid_n == 5 && s.top > s.mid) v -= FOUL_PENALTY;
+            if (mid_n == 5 && bot_n == 5 && s.mid > s.bot) v -= FOUL_PENALTY;
+            // Верхний ряд уже сильнее нижележащего: риск фола растет по мере заполнения нижележащего ряда.
+            if (s.top > s.mid) v -= 20.0 + 10.0 * mid_n / 5.0;
+            if (s.mid > s.bot) v -= 20.0 + 10.0 * bot_n / 5.0;
+            return v + 0.3 * bot_cat + 0.2 * mid_cat;
+        }
+
+        static inline bool put_card(Board& b, int row, Card c) {
+            Card* slots = row == 0 ? b.top.data() : (row == 1 ? b.middle.data() : b.bottom.data());
+            int size = row == 0 ? 3 : 5;
+            for (int i = 0; i < size; ++i) if (slots[i] == INVALID_CARD) { slots[i] = c; return true; }
+            return false;
+        }
+
+        // Перебор расстановок по рядам (3^n вариантов) и, на улицах 2-5, выбор карты сброса.
+        inline void place_cards(Board& board, const Card* cards, int n, bool discard_one) const {
+            Board best_board = board;
+            double best_value = -INFINITY;
+            const int num_discards = discard_one ? n : 1;
+            for (int d = 0; d < num_discards; ++d) {
+                std::array<Card, 5> to_place;
+                int k = 0;
+                for (int i = 0; i < n; ++i) if (!discard_one || i != d) to_place[k++] = cards[i];
+                int combos = 1;
+                for (int i = 0; i < k; ++i) combos *= 3;
+                for (int code = 0; code < combos; ++code) {
+                    Board candidate = board;
+                    bool ok = true;
+                    for (int i = 0, c = code; i < k && ok; ++i, c /= 3) ok = put_card(candidate, c % 3, to_place[i]);
+                    if (!ok) continue;
+                    double v = placement_value(candidate);
+                    if (v > best_value) { best_value = v; best_board = candidate; }
+                }
+            }
+            board = best_board;
+        }
+
+        const HandEvaluator& evaluator_;
+        RolloutConfig config_;
+    };
+
+    struct RolloutBenchmarkResult {
+        int positions = 0;
+        long long rollouts = 0;
+        double seconds = 0.0;
+        double rollouts_per_second = 0.0;
+        double parallel_seconds = 0.0;
+        double parallel_rollouts_per_second = 0.0;
+    };
+
+    // Замер скорости доигрываний: случайные позиции на заданной улице, фиксированное число
+    // доигрываний на позицию — сначала в одном потоке, затем evaluate_parallel на всех потоках.
+    inline RolloutBenchmarkResult benchmark_rollouts(int street, int positions, int rollouts_per_position, uint64_t seed) {
+        HandEvaluator evaluator;
+        RolloutConfig config;
+        config.min_rollouts = config.max_rollouts = rollouts_per_position;
+        config.std_error_target = 0.0;
+        RolloutEvaluator engine(evaluator, config);
+        std::vector<GameState> states = sample_positions(street, positions, seed);
+        omp::XoroShiro128Plus rng(seed);
+
+        RolloutBenchmarkResult result;
+        result.positions = positions;
+        auto t0 = std::chrono::steady_clock::now();
+        for (const auto& state : states) result.rollouts += engine.evaluate(state, rng).rollouts;
+        auto t1 = std::chrono::steady_clock::now();
+        long long parallel_rollouts = 0;
+        for (const auto& state : states) parallel_rollouts += engine.evaluate_parallel(state).rollouts;
+        auto t2 = std::chrono::steady_clock::now();
+
+        result.seconds = std::chrono::duration<double>(t1 - t0).count();
+        result.rollouts_per_second = result.seconds > 0 ? result.rollouts / result.seconds : 0.0;
+        result.parallel_seconds = std::chrono::duration<double>(t2 - t1).count();
+        result.parallel_rollouts_per_second = result.parallel_seconds > 0 ? parallel_rollouts / result.parallel_seconds : 0.0;
+        return result;
+    }
+}
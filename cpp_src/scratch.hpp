@@ -0,0 +1,115 @@
+// mccfr_ofc-main/cpp_src/scratch.hpp
+
+#pragma once
+#include <vector>
+#include <memory>
+#include <memory_resource>
+#include <algorithm>
+#include <cstddef>
+#include <new>
+
+namespace ofc {
+
+    // Арена потока для временных данных обхода: узел берет кадр под действия, состояния,
+    // стратегию и полезности и возвращает его при выходе (LIFO), а в начале итерации арена
+    // сбрасывается целиком. Блоки никогда не освобождаются и не перемещаются, поэтому указатели
+    // кадров родителей остаются валидными, а после прогрева обход не обращается к куче.
+    // Через std::pmr::memory_resource в арену направляются контейнеры (std::pmr::vector и т.п.);
+    // их deallocate ничего не делает — память возвращают release/reset.
+    class ScratchStack : public std::pmr::memory_resource {
+    public:
+        static constexpr size_t BLOCK_ALIGN = 64;
+
+        // Размер блока по умолчанию вмещает обычный кадр; списки действий улицы 1
+        // (~154 тыс. действий) получают отдельные блоки, которые затем переиспользуются.
+        explicit ScratchStack(size_t block_size = 8 << 20) : block_size_(block_size) {}
+
+        ScratchStack(const ScratchStack&) = delete;
+        ScratchStack& operator=(const ScratchStack&) = delete;
+
+        struct Mark {
+            size_t block;
+            size_t offset;
+        };
+
+        inline Mark mark() const { return {current_, offset_}; }
+        inline void release(const Mark& m) { current_ = m.block; offset_ = m.offset; }
+        inline void reset() { current_ = 0; offset_ = 0; }
+
+        inline double* push(size_t n) {
+            return static_cast<double*>(do_allocate(n * sizeof(double), alignof(double)));
+        }
+
+        // Емкость в байтах.
+        inline size_t capacity() const {
+            size_t total = 0;
+            for (const auto& b : blocks_) total += b.size;
+            return total;
+        }
+
+        // Сколько раз арена обращалась к куче за новым блоком (в установившемся режиме не растет).
+        inline long long block_allocations() const { return block_allocations_; }
+
+    protected:
+        void* do_allocate(size_t bytes, size_t alignment) override {
+            if (alignment > BLOCK_ALIGN) throw std::bad_alloc();
+            if (bytes == 0) bytes = 1;
+            size_t offset = align_up(offset_, alignment);
+            if (blocks_.empty() || offset + bytes > blocks_[current_].size) {
+                // Следующий блок, вмещающий запрос; блоки между ним и текущим пропускаются до release.
+                size_t next = blocks_.empty() ? 0 : current_ + 1;
+                while (next < blocks_.size() && blocks_[next].size < bytes) next++;
+                if (next == blocks_.size()) {
+                    blocks_.push_back(make_block(std::max(align_up(bytes, BLOCK_ALIGN), block_size_)));
+                    block_allocations_++;
+                }
+                current_ = next;
+                offset = 0;
+            }
+            void* p = blocks_[current_].data.get() + offset;
+            offset_ = offset + bytes;
+            return p;
+        }
+
+        void do_deallocate(void*, size_t, size_t) override {}
+
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+
+    private:
+        struct BlockDeleter {
+            void operator()(std::byte* p) const { ::operator delete(p, std::align_val_t(BLOCK_ALIGN)); }
+        };
+
+        struct Block {
+            std::unique_ptr<std::byte, BlockDeleter> data;
+            size_t size;
+        };
+
+        static inline size_t align_up(size_t value, size_t alignment) { return (value + alignment - 1) & ~(alignment - 1); }
+
+        static inline Block make_block(size_t n) {
+            return {std::unique_ptr<std::byte, BlockDeleter>(static_cast<std::byte*>(::operator new(n, std::align_val_t(BLOCK_ALIGN)))), n};
+        }
+
+        std::vector<Block> blocks_;
+        size_t block_size_;
+        size_t current_ = 0;
+        size_t offset_ = 0;
+        long long block_allocations_ = 0;
+    };
+
+    // Кадр на время обработки одного узла: все взятое из стека после его создания возвращается в деструкторе.
+    class ScratchFrame {
+    public:
+        explicit ScratchFrame(ScratchStack& stack) : stack_(stack), mark_(stack.mark()) {}
+        ~ScratchFrame() { stack_.release(mark_); }
+        ScratchFrame(const ScratchFrame&) = delete;
+        ScratchFrame& operator=(const ScratchFrame&) = delete;
+
+        inline double* alloc(size_t n) { return stack_.push(n); }
+
+    private:
+        ScratchStack& stack_;
+        ScratchStack::Mark mark_;
+    };
+}
@@ -0,0 +1,316 @@
+// mccfr_ofc-main/cpp_src/self_checks.hpp
+
+#pragma once
+#include "mccfr_solver.hpp"
+#include <stdexcept>
+#include <string>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <iostream>
+#include <map>
+
+namespace ofc {
+
+    // Проверки поведения на случайных данных (python -m ofc_bot.bench check). Каждая при
+    // расхождении бросает std::runtime_error с описанием, иначе возвращает число проверенных случаев.
+
+    // Временный файл проверки и его содержимое (решатели сравниваются по файлам стратегии).
+    inline std::string check_file_path(const std::string& name, uint64_t seed) {
+        return (std::filesystem::temp_directory_path() / ("ofc_check_" + name + "_" + std::to_string(seed) + ".bin")).string();
+    }
+
+    inline std::string read_check_file(const std::string& path) {
+        std::ifstream in(path, std::ios::binary);
+        std::string bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        std::filesystem::remove(path);
+        return bytes;
+    }
+
+    // Границы рядов и гарантированный фол против полного перебора дозаполнений доски
+    // с одним или двумя свободными слотами (точная ветка get_row_bounds).
+    inline int check_foul_bounds(int boards, uint64_t seed) {
+        HandEvaluator evaluator;
+        omp::XoroShiro128Plus rng(seed);
+        std::array<Card, 52> deck;
+        std::iota(deck.begin(), deck.end(), 0);
+
+        for (int b = 0; b < boards; ++b) {
+            for (int i = 51; i > 0; --i) std::swap(deck[i], deck[rng() % (uint64_t)(i + 1)]);
+            Board board;
+            std::array<Card*, 13> slots;
+            int k = 0;
+            for (Card& c : board.top) slots[k++] = &c;
+            for (Card& c : board.middle) slots[k++] = &c;
+            for (Card& c : board.bottom) slots[k++] = &c;
+            for (int i = 0; i < 13; ++i) *slots[i] = deck[i];
+
+            // Освобождаем 1-2 слота; еще 10 карт колоды считаем мертвыми (чужая доска, сбросы).
+            int free_count = 1 + (int)(rng() % 2);
+            std::array<Card*, 2> free_slots;
+            for (int f = 0; f < free_count; ++f) {
+                int s;
+                do { s = (int)(rng() % 13); } while (*slots[s] == INVALID_CARD);
+                *slots[s] = INVALID_CARD;
+                free_slots[f] = slots[s];
+            }
+            CardMask live = FULL_DECK_MASK & ~board_mask(board);
+            for (int i = 13; i < 23; ++i) live &= ~card_bit(deck[i]);
+
+            std::array<RowBounds, 3> exact;
+            exact.fill({MAX_HAND_STRENGTH, 0});
+            bool all_foul = true;
+            auto row_strength = [&](const Card* cards, int n) {
+                omp::Hand h = omp::Hand::empty();
+                for (int i = 0; i < n; ++i) h += omp::Hand(cards[i]);
+                return evaluator.strength(h);
+            };
+            auto visit = [&](const Board& full) {
+                std::array<int, 3> s = {row_strength(full.top.data(), 3), row_strength(full.middle.data(), 5),
+                                        row_strength(full.bottom.data(), 5)};
+                for (int r = 0; r < 3; ++r) {
+                    exact[r].min_strength = std::min(exact[r].min_strength, s[r]);
+                    exact[r].max_strength = std::max(exact[r].max_strength, s[r]);
+                }
+                all_foul = all_foul && full.is_foul(evaluator);
+            };
+            for (Card c1 = 0; c1 < 52; ++c1) {
+                if (!(live & card_bit(c1))) continue;
+                *free_slots[0] = c1;
+                if (free_count == 1) { visit(board); continue; }
+                for (Card c2 = 0; c2 < 52; ++c2) {
+                    if (c2 == c1 || !(live & card_bit(c2))) continue;
+                    *free_slots[1] = c2;
+                    visit(board);
+                }
+            }
+            for (int f = 0; f < free_count; ++f) *free_slots[f] = INVALID_CARD;
+
+            std::array<RowBounds, 3> bounds = {get_row_bounds(board.top, live, evaluator),
+                                               get_row_bounds(board.middle, live, evaluator),
+                                               get_row_bounds(board.bottom, live, evaluator)};
+            for (int r = 0; r < 3; ++r) {
+                if (bounds[r].min_strength != exact[r].min_strength || bounds[r].max_strength != exact[r].max_strength) {
+                    throw std::runtime_error("check_foul_bounds: row " + std::to_string(r) + " bounds [" +
+                                             std::to_string(bounds[r].min_strength) + ", " + std::to_string(bounds[r].max_strength) +
+                                             "], exhaustive [" + std::to_string(exact[r].min_strength) + ", " +
+                                             std::to_string(exact[r].max_strength) + "] on board " + std::to_string(b));
+                }
+            }
+            if (is_certain_foul(board, live, evaluator) && !all_foul) {
+                throw std::runtime_error("check_foul_bounds: certain foul with a non-fouling completion on board " + std::to_string(b));
+            }
+        }
+        return boards;
+    }
+
+    // Движок расстановки фантазии против полного перебора низ/середина/верх для рук из 13-15 карт:
+    // счет (роялти + повтор) совпадает с максимумом перебора, доска без фола и с заявленным роялти.
+    // Половина рук набирается из карт шести случайных рангов, чтобы чаще встречались сеты и каре.
+    inline int check_fantasyland_solver(int hands, uint64_t seed) {
+        HandEvaluator evaluator;
+        FantasylandSolver solver(evaluator);
+        const double repeat = solver.get_repeat_bonus();
+        omp::XoroShiro128Plus rng(seed);
+
+        for (int h = 0; h < hands; ++h) {
+            std::vector<Card> pool;
+            if (h % 2 == 0) {
+                pool.resize(52);
+                std::iota(pool.begin(), pool.end(), 0);
+            } else {
+                std::array<int, 13> ranks;
+                std::iota(ranks.begin(), ranks.end(), 0);
+                for (int i = 12; i > 0; --i) std::swap(ranks[i], ranks[rng() % (uint64_t)(i + 1)]);
+                for (int r = 0; r < 6; ++r) for (int suit = 0; suit < 4; ++suit) pool.push_back((Card)(ranks[r] * 4 + suit));
+            }
+            const int n = 13 + h % 3;
+            for (int i = 0; i < n; ++i) std::swap(pool[i], pool[i + rng() % (uint64_t)(pool.size() - i)]);
+            CardSet cards(pool.begin(), pool.begin() + n);
+
+            // Ранг (меньше — сильнее) и роялти каждого 3- и 5-карточного подмножества по маске индексов.
+            std::vector<int> rank(1u << n), top_royalty(1u << n), middle_royalty(1u << n), bottom_royalty(1u << n);
+            std::vector<char> top_trips(1u << n);
+            std::vector<uint32_t> fives, threes;
+            for (uint32_t m = 0; m < (1u << n); ++m) {
+                int k = __builtin_popcount(m);
+                if (k != 3 && k != 5) continue;
+                std::array<Card, 5> buf;
+                int j = 0;
+                for (int i = 0; i < n; ++i) if (m & (1u << i)) buf[j++] = cards[i];
+                rank[m] = evaluator.evaluate(buf.data(), k).rank_value;
+                if (k == 3) {
+                    top_royalty[m] = evaluator.get_royalty(buf.data(), 3, "top");
+                    top_trips[m] = get_rank(buf[0]) == get_rank(buf[1]) && get_rank(buf[1]) == get_rank(buf[2]);
+                    threes.push_back(m);
+                } else {
+                    middle_royalty[m] = evaluator.get_royalty(buf.data(), 5, "middle");
+                    bottom_royalty[m] = evaluator.get_royalty(buf.data(), 5, "bottom");
+                    fives.push_back(m);
+                }
+            }
+            const int quads_rank = HandEvaluator::RANK_CEIL - (int)omp::FOUR_OF_A_KIND;
+
+            double best = -1.0;
+            for (uint32_t bot : fives) {
+                const bool bottom_repeats = rank[bot] <= quads_rank;
+                for (uint32_t mid : fives) {
+                    if ((mid & bot) || rank[mid] < rank[bot]) continue;
+                    for (uint32_t top : threes) {
+                        if ((top & (bot | mid)) || rank[top] < rank[mid]) continue;
+                        double score = bottom_royalty[bot] + middle_royalty[mid] + top_royalty[top] +
+                                       (bottom_repeats || top_trips[top] ? repeat : 0.0);
+                        best = std::max(best, score);
+                    }
+                }
+            }
+
+            FantasylandResult result = solver.solve(cards);
+            const std::string where = " on hand " + std::to_string(h) + " (" + std::to_string(n) + " cards)";
+            if (result.valid != (best >= 0)) throw std::runtime_error("check_fantasyland_solver: validity mismatch" + where);
+            if (!result.valid) continue;
+            if (std::abs(result.score - best) > 1e-9) {
+                throw std::runtime_error("check_fantasyland_solver: score " + std::to_string(result.score) +
+                                         ", exhaustive " + std::to_string(best) + where);
+            }
+            if (result.board.get_card_count() != 13 || result.board.is_foul(evaluator)) {
+                throw std::runtime_error("check_fantasyland_solver: returned board is incomplete or fouls" + where);
+            }
+            double board_score = result.board.get_total_royalty(evaluator) + (solver.stays_in_fantasyland(result.board) ? repeat : 0.0);
+            if (result.royalty != result.board.get_total_royalty(evaluator) || std::abs(board_score - best) > 1e-9) {
+                throw std::runtime_error("check_fantasyland_solver: returned board scores " + std::to_string(board_score) + where);
+            }
+        }
+        return hands;
+    }
+
+    // Узлы файла стратегии по ключам: число действий и байты накопителей в кодировке encoding.
+    // header_bytes — длина заголовка до числа узлов (0 — прежний формат без заголовка).
+    inline std::map<std::string, std::pair<int, std::string>> strategy_file_nodes(const std::string& bytes, size_t header_bytes,
+                                                                                  const NodeEncoding& encoding) {
+        std::map<std::string, std::pair<int, std::string>> nodes;
+        size_t pos = header_bytes;
+        auto take = [&](size_t n) {
+            if (pos + n > bytes.size()) throw std::runtime_error("strategy file is truncated");
+            pos += n;
+            return bytes.data() + pos - n;
+        };
+        size_t map_size;
+        std::memcpy(&map_size, take(sizeof(map_size)), sizeof(map_size));
+        for (size_t i = 0; i < map_size; ++i) {
+            size_t key_len;
+            std::memcpy(&key_len, take(sizeof(key_len)), sizeof(key_len));
+            std::string key(take(key_len), key_len);
+            int num_actions;
+            std::memcpy(&num_actions, take(sizeof(num_actions)), sizeof(num_actions));
+            const size_t n = encoding.file_bytes(num_actions);
+            nodes[key] = {num_actions, std::string(take(n), n)};
+        }
+        if (pos != bytes.size()) throw std::runtime_error("strategy file has trailing bytes");
+        return nodes;
+    }
+
+    // load_strategy без сообщения о числе загруженных узлов.
+    inline void load_quietly(MCCFRSolver& solver, const std::string& path) {
+        std::streambuf* out = std::cout.rdbuf(nullptr);
+        solver.load_strategy(path);
+        std::cout.rdbuf(out);
+        std::cout.clear();
+    }
+
+    // Файлы стратегии. Текущий формат (версия 6): решатель Pure CFR с базовыми значениями,
+    // сохраненный, загруженный и снова сохраненный, дает тот же заголовок и те же узлы.
+    // Прежний формат без заголовка (double, сожаления и веса подряд) пишется здесь вручную
+    // и после загрузки и сохранения дает те же значения.
+    inline int check_strategy_files(int positions, uint64_t seed) {
+        // Заголовок версии 6: сигнатура, версия, хранение, масштаб и нижняя граница сожалений,
+        // top_k, число итераций, флаги прогнозов и базовых значений.
+        const size_t header_bytes = 8 + 4 + 4 + 8 + 8 + 4 + 8 + 4 + 4;
+        std::vector<GameState> roots = sample_positions(4, positions, seed);
+        SolverConfig config;
+        config.num_threads = 1;
+        config.storage = STORAGE_INT32;
+        config.pure_cfr = 1;
+        config.vr_baselines = 1;
+        NodeEncoding encoding;
+        encoding.storage = STORAGE_INT32;
+        encoding.baselines = true;
+
+        MCCFRSolver trained;
+        trained.set_config(config);
+        for (int pass = 0; pass < 3; ++pass) trained.train_positions(roots);
+        const std::string first_path = check_file_path("v6", seed);
+        trained.save_strategy(first_path);
+        MCCFRSolver loaded;
+        loaded.set_config(config);
+        load_quietly(loaded, first_path);
+        const std::string saved = read_check_file(first_path);
+        const std::string second_path = check_file_path("v6_again", seed);
+        loaded.save_strategy(second_path);
+        const std::string resaved = read_check_file(second_path);
+        if (saved.compare(0, header_bytes, resaved, 0, header_bytes) != 0) throw std::runtime_error("check_strategy_files: v6 header changed on reload");
+        const auto nodes = strategy_file_nodes(saved, header_bytes, encoding);
+        if (nodes.empty() || nodes != strategy_file_nodes(resaved, header_bytes, encoding)) {
+            throw std::runtime_error("check_strategy_files: v6 nodes changed on reload (" + std::to_string(nodes.size()) + " nodes)");
+        }
+
+        omp::XoroShiro128Plus rng(seed);
+        const std::string legacy_path = check_file_path("legacy", seed);
+        std::map<std::string, std::pair<int, std::string>> legacy;
+        {
+            std::ofstream out(legacy_path, std::ios::binary);
+            const size_t map_size = 64;
+            out.write(reinterpret_cast<const char*>(&map_size), sizeof(map_size));
+            for (size_t i = 0; i < map_size; ++i) {
+                const std::string key = "legacy/" + std::to_string(rng());
+                const int num_actions = 1 + (int)(rng() % 40);
+                std::vector<double> values(2 * (size_t)num_actions);
+                for (double& v : values) v = ((double)(rng() >> 11) * 0x1.0p-53 - 0.5) * 1000.0;
+                for (int a = 0; a < num_actions; ++a) values[num_actions + a] = std::abs(values[num_actions + a]);
+                const size_t key_len = key.size();
+                out.write(reinterpret_cast<const char*>(&key_len), sizeof(key_len));
+                out.write(key.data(), key_len);
+                out.write(reinterpret_cast<const char*>(&num_actions), sizeof(num_actions));
+                out.write(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(double));
+                legacy[key] = {num_actions, std::string(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(double))};
+            }
+        }
+        MCCFRSolver from_legacy;
+        load_quietly(from_legacy, legacy_path);
+        std::filesystem::remove(legacy_path);
+        const std::string converted_path = check_file_path("legacy_v6", seed);
+        from_legacy.save_strategy(converted_path);
+        if (from_legacy.get_iteration_count() != 0 || strategy_file_nodes(read_check_file(converted_path), header_bytes, NodeEncoding{}) != legacy) {
+            throw std::runtime_error("check_strategy_files: legacy file did not round-trip through v6");
+        }
+        return (int)(nodes.size() + legacy.size());
+    }
+
+    // Отсечение не влияет на решатели, обучаемые после него в том же потоке: обучение без отсечения
+    // до и после обучения с отсечением (общая арена потока) дает побайтно тот же файл стратегии.
+    // Генератор потока перед каждым обучением без отсечения заводится заново.
+    inline int check_pruning_isolation(int positions, uint64_t seed) {
+        std::vector<GameState> roots = sample_positions(4, positions, seed);
+        auto train = [&](int pruning, const std::string& name) {
+            MCCFRSolver solver;
+            SolverConfig config = solver.get_config();
+            config.num_threads = 1;
+            config.regret_pruning = pruning;
+            config.prune_warmup = 0;
+            config.prune_threshold = -0.5;
+            config.prune_explore = 0.0;
+            solver.set_config(config);
+            thread_rng() = omp::XoroShiro128Plus(seed);
+            for (int pass = 0; pass < 3; ++pass) solver.train_positions(roots);
+            const std::string path = check_file_path(name, seed);
+            solver.save_strategy(path);
+            return std::make_pair(read_check_file(path), solver.get_pruned_edges());
+        };
+        const std::string before = train(0, "unpruned").first;
+        if (train(1, "pruned").second == 0) throw std::runtime_error("check_pruning_isolation: the pruned run pruned nothing");
+        if (train(0, "unpruned").first != before) {
+            throw std::runtime_error("check_pruning_isolation: unpruned training differs after a pruned run on the same thread");
+        }
+        return positions;
+    }
+}
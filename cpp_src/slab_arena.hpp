@@ -0,0 +1,119 @@
+// mccfr_ofc-main/cpp_src/slab_arena.hpp
+
+#pragma once
+#include "numa.hpp"
+#include <vector>
+#include <memory_resource>
+#include <algorithm>
+#include <cstdint>
+#include <new>
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+namespace ofc {
+
+    // Арена шарда таблицы узлов: записи узлов и индекс лежат подряд в больших кусках памяти (слябах),
+    // которые берутся через mmap. Узлы живут до очистки таблицы, поэтому память освобождается
+    // только целиком в деструкторе. Вызовы идут под блокировкой шарда, своей синхронизации нет.
+    // В режимах NUMA куски до первого касания привязываются к узлам (mbind); если ядро отказало,
+    // кусок остается на политике первого касания (см. bind_failures). huge_pages просит ядро
+    // отдать куски прозрачными страницами по 2 МБ: меньше промахов TLB на большой таблице.
+    // Куски растут вдвое от first_chunk до MAX_CHUNK: маленькая таблица не держит лишнего.
+    class SlabArena : public std::pmr::memory_resource {
+    public:
+        static constexpr size_t HUGE_PAGE = 2 << 20;
+        static constexpr size_t MAX_CHUNK = 64 << 20;
+
+        explicit SlabArena(NumaMode mode = NUMA_OFF, std::vector<int> node_ids = {}, bool huge_pages = false,
+                           size_t first_chunk = 256 << 10)
+            : mode_(mode), node_ids_(std::move(node_ids)), huge_pages_(huge_pages), chunk_size_(first_chunk) {}
+
+        ~SlabArena() override {
+#ifdef __linux__
+            for (const Chunk& c : chunks_) munmap(c.data, c.size);
+#else
+            for (const Chunk& c : chunks_) ::operator delete(c.data);
+#endif
+        }
+
+        SlabArena(const SlabArena&) = delete;
+        SlabArena& operator=(const SlabArena&) = delete;
+
+        inline int bind_failures() const { return bind_failures_; }
+        inline size_t chunk_count() const { return chunks_.size(); }
+        // Байт выдано (включая выравнивание) и байт взято у системы.
+        inline size_t used_bytes() const { return used_bytes_; }
+        inline size_t mapped_bytes() const {
+            size_t total = 0;
+            for (const Chunk& c : chunks_) total += c.size;
+            return total;
+        }
+
+    protected:
+        void* do_allocate(size_t bytes, size_t alignment) override {
+            size_t offset = (offset_ + alignment - 1) & ~(alignment - 1);
+            if (chunks_.empty() || offset + bytes > chunks_.back().size) {
+                new_chunk(std::max(bytes + alignment, chunk_size_));
+                chunk_size_ = std::min(2 * chunk_size_, MAX_CHUNK);
+                offset = 0;
+            }
+            Chunk& c = chunks_.back();
+            void* p = static_cast<char*>(c.data) + offset;
+            used_bytes_ += offset + bytes - offset_;
+            offset_ = offset + bytes;
+            return p;
+        }
+
+        void do_deallocate(void*, size_t, size_t) override {}
+
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+
+    private:
+        struct Chunk {
+            void* data;
+            size_t size;
+        };
+
+        inline void new_chunk(size_t size) {
+#ifdef __linux__
+            const size_t page = huge_pages_ ? HUGE_PAGE : 4096;
+            size = (size + page - 1) & ~(page - 1);
+            void* data = map_chunk(size);
+            if (mode_ != NUMA_OFF && !bind_memory(data, size, mode_, node_ids_)) bind_failures_++;
+#ifdef MADV_HUGEPAGE
+            if (huge_pages_) madvise(data, size, MADV_HUGEPAGE);
+#endif
+#else
+            void* data = ::operator new(size);
+            if (mode_ != NUMA_OFF) bind_failures_++;
+#endif
+            chunks_.push_back({data, size});
+            offset_ = 0;
+        }
+
+#ifdef __linux__
+        // Для больших страниц кусок выравнивается на 2 МБ: лишнее по краям возвращается системе.
+        inline void* map_chunk(size_t size) {
+            const size_t extra = huge_pages_ ? HUGE_PAGE : 0;
+            void* raw = mmap(nullptr, size + extra, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (raw == MAP_FAILED) throw std::bad_alloc();
+            if (!extra) return raw;
+            const uintptr_t begin = reinterpret_cast<uintptr_t>(raw);
+            const uintptr_t aligned = (begin + HUGE_PAGE - 1) & ~(uintptr_t)(HUGE_PAGE - 1);
+            if (aligned > begin) munmap(raw, aligned - begin);
+            if (aligned + size < begin + size + extra) munmap(reinterpret_cast<void*>(aligned + size), begin + extra - aligned);
+            return reinterpret_cast<void*>(aligned);
+        }
+#endif
+
+        NumaMode mode_;
+        std::vector<int> node_ids_;
+        bool huge_pages_;
+        size_t chunk_size_;
+        std::vector<Chunk> chunks_;
+        size_t offset_ = 0;
+        size_t used_bytes_ = 0;
+        int bind_failures_ = 0;
+    };
+}
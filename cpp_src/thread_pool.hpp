@@ -0,0 +1,252 @@
+// mccfr_ofc-main/cpp_src/thread_pool.hpp
+
+#pragma once
+#include <vector>
+#include <array>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <algorithm>
+#include <cstdint>
+#include "numa.hpp"
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace ofc {
+
+    // Собственный пул потоков решателя, не зависящий от рантайма OpenMP: постоянные потоки
+    // переживают вызовы train(), размер задается явно, потоки можно закрепить за ядрами.
+    // Задачи fork-join (TaskGroup) — POD-записи (функция и указатель на аргументы в кадре
+    // родителя) в кольце фиксированной емкости у текущего потока, без обращений к куче.
+    // Ожидающий поток выполняет свои задачи (LIFO) или ворует чужие (FIFO), а когда работы нет —
+    // засыпает до появления задачи или завершения группы. Украденная задача выполняется
+    // вложенным вызовом на стеке ожидающего, поэтому арены потоков остаются LIFO.
+    // При переполнении кольца задача выполняется сразу.
+    // С топологией NUMA потоки распределяются по узлам по кругу (поток i — узел i % N),
+    // закрепляются за ядрами своего узла и знают его через current_numa_node().
+    class ThreadPool {
+    public:
+        struct TaskGroup {
+            std::atomic<int> pending{0};
+        };
+
+        using TaskFn = void (*)(void*);
+        static constexpr uint32_t TASK_QUEUE_CAPACITY = 4096;
+
+        ThreadPool(int num_threads, bool pin_threads, const NumaTopology* topology = nullptr) {
+            if (num_threads <= 0) throw std::invalid_argument("Thread pool needs at least one thread");
+            queues_.reserve(num_threads);
+            for (int i = 0; i < num_threads; ++i) queues_.push_back(std::make_unique<Queue>());
+            std::vector<int> cpus = pin_threads ? allowed_cpus() : std::vector<int>();
+            const int num_nodes = topology ? std::max(1, topology->num_nodes()) : 1;
+            workers_.reserve(num_threads);
+            for (int i = 0; i < num_threads; ++i) {
+                const int node = topology ? i % num_nodes : -1;
+                workers_.emplace_back([this, i, node] { worker_loop(i, node); });
+                const std::vector<int>& node_cpus = node >= 0 && !topology->node_cpus[node].empty() ? topology->node_cpus[node] : cpus;
+                if (pin_threads && !node_cpus.empty()) pin(workers_.back(), node_cpus[(i / num_nodes) % node_cpus.size()]);
+            }
+        }
+
+        ~ThreadPool() {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                stop_ = true;
+            }
+            start_cv_.notify_all();
+            for (auto& w : workers_) w.join();
+        }
+
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+
+        inline int size() const { return (int)workers_.size(); }
+
+        // Индекс потока пула, выполняющего код (-1 вне пула).
+        static inline int& current_worker() {
+            thread_local int index = -1;
+            return index;
+        }
+
+        // Запускает job(индекс потока) на всех потоках пула и ждет, пока все закончат.
+        // Закончившие раньше помогают остальным с их задачами.
+        inline void run_on_all(const std::function<void(int)>& job) {
+            std::lock_guard<std::mutex> run_lock(run_mutex_);
+            std::unique_lock<std::mutex> lock(mutex_);
+            job_ = &job;
+            running_.store(size());
+            finished_ = 0;
+            generation_++;
+            start_cv_.notify_all();
+            done_cv_.wait(lock, [this] { return finished_ == size(); });
+            job_ = nullptr;
+        }
+
+        // args должен жить до wait(group): обычно это запись в кадре арены родителя.
+        inline void submit(TaskGroup& group, TaskFn fn, void* args) {
+            const int self = current_worker();
+            if (self < 0) { fn(args); return; }  // вне пула задача выполняется сразу
+            Queue& q = *queues_[self];
+            {
+                std::lock_guard<std::mutex> lock(q.mutex);
+                if (q.tail - q.head < TASK_QUEUE_CAPACITY) {
+                    group.pending.fetch_add(1, std::memory_order_relaxed);
+                    q.tasks[q.tail++ % TASK_QUEUE_CAPACITY] = {fn, args, &group};
+                    fn = nullptr;
+                }
+            }
+            if (fn) fn(args);
+            else signal();
+        }
+
+        inline void wait(TaskGroup& group) {
+            const int self = current_worker();
+            wait_until(self, [&] { return group.pending.load(std::memory_order_acquire) == 0; });
+        }
+
+    private:
+        struct Task {
+            TaskFn fn;
+            void* args;
+            TaskGroup* group;
+        };
+
+        struct alignas(64) Queue {
+            std::mutex mutex;
+            uint32_t head = 0;  // отсюда воруют
+            uint32_t tail = 0;  // сюда кладет и отсюда берет владелец
+            std::array<Task, TASK_QUEUE_CAPACITY> tasks;
+        };
+
+        inline bool try_run_one(int self) {
+            Task task;
+            if (!pop_own(self, task) && !steal(self, task)) return false;
+            task.fn(task.args);
+            if (task.group->pending.fetch_sub(1, std::memory_order_acq_rel) == 1) signal();
+            return true;
+        }
+
+        inline bool pop_own(int self, Task& out) {
+            if (self < 0) return false;
+            Queue& q = *queues_[self];
+            std::lock_guard<std::mutex> lock(q.mutex);
+            if (q.head == q.tail) return false;
+            out = q.tasks[--q.tail % TASK_QUEUE_CAPACITY];
+            return true;
+        }
+
+        inline bool steal(int self, Task& out) {
+            const int n = size();
+            for (int k = 1; k <= n; ++k) {
+                Queue& q = *queues_[(self + k + n) % n];
+                std::lock_guard<std::mutex> lock(q.mutex);
+                if (q.head == q.tail) continue;
+                out = q.tasks[q.head++ % TASK_QUEUE_CAPACITY];
+                return true;
+            }
+            return false;
+        }
+
+        // Выполняет свои и чужие задачи, пока не выполнится done(). Без работы поток недолго
+        // крутится, затем спит до сигнала: новой задачи или завершения чьей-то группы.
+        template<class Done>
+        inline void wait_until(int self, Done done) {
+            int idle = 0;
+            while (!done()) {
+                const uint64_t seen = signals_.load(std::memory_order_acquire);
+                if (try_run_one(self)) { idle = 0; continue; }
+                if (done()) return;
+                if (++idle < IDLE_SPINS) { cpu_relax(); continue; }
+                std::unique_lock<std::mutex> lock(idle_mutex_);
+                sleepers_.fetch_add(1, std::memory_order_seq_cst);
+                idle_cv_.wait(lock, [&] { return signals_.load(std::memory_order_seq_cst) != seen; });
+                sleepers_.fetch_sub(1, std::memory_order_relaxed);
+                idle = 0;
+            }
+        }
+
+        inline void signal() {
+            signals_.fetch_add(1, std::memory_order_seq_cst);
+            if (sleepers_.load(std::memory_order_seq_cst) > 0) {
+                std::lock_guard<std::mutex> lock(idle_mutex_);
+                idle_cv_.notify_all();
+            }
+        }
+
+        static inline void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+            __builtin_ia32_pause();
+#else
+            std::this_thread::yield();
+#endif
+        }
+
+        static constexpr int IDLE_SPINS = 256;
+
+        inline void worker_loop(int index, int numa_node) {
+            current_worker() = index;
+            current_numa_node() = numa_node;
+            uint64_t seen = 0;
+            while (true) {
+                const std::function<void(int)>* job;
+                {
+                    std::unique_lock<std::mutex> lock(mutex_);
+                    start_cv_.wait(lock, [&] { return stop_ || generation_ != seen; });
+                    if (stop_) return;
+                    seen = generation_;
+                    job = job_;
+                }
+                (*job)(index);
+                if (running_.fetch_sub(1) == 1) signal();
+                wait_until(index, [this] { return running_.load() == 0; });
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (++finished_ == size()) done_cv_.notify_one();
+            }
+        }
+
+        static inline std::vector<int> allowed_cpus() {
+            std::vector<int> cpus;
+#ifdef __linux__
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+                for (int c = 0; c < CPU_SETSIZE; ++c) if (CPU_ISSET(c, &set)) cpus.push_back(c);
+            }
+#endif
+            return cpus;
+        }
+
+        static inline void pin(std::thread& thread, int cpu) {
+#ifdef __linux__
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(cpu, &set);
+            pthread_setaffinity_np(thread.native_handle(), sizeof(set), &set);
+#else
+            (void)thread; (void)cpu;
+#endif
+        }
+
+        std::vector<std::unique_ptr<Queue>> queues_;
+        std::vector<std::thread> workers_;
+        std::mutex run_mutex_;
+        std::mutex mutex_;
+        std::condition_variable start_cv_;
+        std::condition_variable done_cv_;
+        std::mutex idle_mutex_;
+        std::condition_variable idle_cv_;
+        std::atomic<uint64_t> signals_{0};
+        std::atomic<int> sleepers_{0};
+        const std::function<void(int)>* job_ = nullptr;
+        uint64_t generation_ = 0;
+        int finished_ = 0;
+        std::atomic<int> running_{0};
+        bool stop_ = false;
+    };
+}
@@ -1,3 +1,7 @@
-from .solver import Solver
+from .solver import Solver, build_fantasyland_table, benchmark_rollouts, benchmark_arena, benchmark_numa, \
+    benchmark_interleave, benchmark_prefetch, benchmark_lazy_nodes, benchmark_hogwild, \
+    benchmark_baselines, benchmark_schedules, run_checks
 
-__all__ = ['Solver']
+__all__ = ['Solver', 'build_fantasyland_table', 'benchmark_rollouts', 'benchmark_arena', 'benchmark_numa', 'benchmark_interleave',
+           'benchmark_prefetch', 'benchmark_lazy_nodes', 'benchmark_hogwild', 'benchmark_baselines',
+           'benchmark_schedules', 'run_checks']
@@ -0,0 +1,171 @@
+"""Бенчмарки решателя. Пример: python -m ofc_bot.bench rollouts --street 3"""
+import argparse
+
+from .solver import benchmark_rollouts, benchmark_arena, benchmark_numa, benchmark_interleave, benchmark_prefetch, \
+    benchmark_lazy_nodes, benchmark_hogwild, benchmark_baselines, benchmark_schedules, run_checks
+
+
+def run_rollouts(args):
+    r = benchmark_rollouts(args.street, args.positions, args.rollouts, args.seed)
+    print("rollouts: %d positions, %d rollouts" % (r['positions'], r['rollouts']))
+    print("  1 thread:    %.0f rollouts/s" % r['rollouts_per_second'])
+    print("  all threads: %.0f rollouts/s" % r['parallel_rollouts_per_second'])
+
+
+def run_arena(args):
+    r = benchmark_arena(args.street, args.iterations, args.seed)
+    print("arena: %d iterations from street %d, %d infosets, %.2f s" % (r['iterations'], args.street, r['nodes'], r['seconds']))
+    print("  arena refills, first iteration: %d" % r['warmup_refills'])
+    print("  arena refills, later iterations: %d" % r['steady_refills'])
+
+
+def run_numa(args):
+    r = benchmark_numa(args.street, args.positions, args.passes, args.threads, args.seed)
+    print("numa: %d nodes, %d threads, %d positions x %d passes, %d infosets" %
+          (r['numa_nodes'], r['threads'], r['positions'], args.passes, r['nodes']))
+    print("  local shards:    %.2f s" % r['local_seconds'])
+    print("  interleaved:     %.2f s" % r['interleaved_seconds'])
+    if r['bind_failures']:
+        print("  mbind failed for %d chunks (first-touch placement)" % r['bind_failures'])
+
+
+def run_interleave(args):
+    r = benchmark_interleave(args.street, args.positions, args.width, args.seed)
+    print("interleave: %d positions from street %d, %d infosets" % (r['positions'], args.street, r['nodes']))
+    print("  recursive:          %.3f s" % r['serial_seconds'])
+    print("  %2d interleaved:     %.3f s" % (r['width'], r['interleaved_seconds']))
+
+
+def run_prefetch(args):
+    r = benchmark_prefetch(args.street, args.positions, args.distance, args.seed)
+    print("prefetch: %d positions from street %d, %d infosets, %d child prefetches" %
+          (r['positions'], args.street, r['nodes'], r['prefetches']))
+    for name, seconds, misses in (("no lookahead", r['baseline_seconds'], r['baseline_cache_misses']),
+                                  ("distance %d" % r['distance'], r['prefetch_seconds'], r['prefetch_cache_misses'])):
+        miss_text = "%d LLC misses" % misses if misses >= 0 else "LLC misses n/a"
+        print("  %-14s %.3f s, %s" % (name + ":", seconds, miss_text))
+
+
+def run_lazy_nodes(args):
+    r = benchmark_lazy_nodes(args.street, args.positions, args.passes, args.visits, args.seed)
+    print("lazy nodes: %d positions from street %d x %d passes" % (r['positions'], args.street, r['passes']))
+    print("  eager:           %d nodes, %.0f KB, %.2f s" % (r['eager_nodes'], r['eager_bytes'] / 1024.0, r['eager_seconds']))
+    print("  on visit %d:      %d nodes + %d counters, %.0f KB, %.2f s" %
+          (r['visits'], r['lazy_nodes'], r['lazy_counters'], r['lazy_bytes'] / 1024.0, r['lazy_seconds']))
+    if r['eager_bytes']:
+        print("  saved:           %.1f%%" % (100.0 * (r['eager_bytes'] - r['lazy_bytes']) / r['eager_bytes']))
+    print("  Pure CFR:        %d nodes, %.0f KB with strategy sums in every record, %.0f KB allocated lazily" %
+          (r['pure_nodes'], r['pure_eager_bytes'] / 1024.0, r['pure_lazy_bytes'] / 1024.0))
+
+
+def run_hogwild(args):
+    r = benchmark_hogwild(args.street, args.positions, args.passes, args.threads, args.seed)
+    print("hogwild: %d threads, %d positions from street %d, %d infosets" % (r['threads'], r['positions'], args.street, r['nodes']))
+    print("  pass   locked: s / mean regret     hogwild: s / mean regret")
+    for p in range(len(r['locked_seconds'])):
+        print("  %4d   %8.2f / %-14.4f   %8.2f / %.4f" % (p + 1, r['locked_seconds'][p], r['locked_regret'][p],
+                                                       r['hogwild_seconds'][p], r['hogwild_regret'][p]))
+
+
+def run_baselines(args):
+    r = benchmark_baselines(args.street, args.positions, args.passes, args.seed)
+    print("baselines: Pure CFR, %d positions from street %d x %d passes, %d infosets" %
+          (r['positions'], args.street, r['passes'], r['nodes']))
+    for name, prefix in (("plain", 'plain'), ("vr baselines", 'baseline')):
+        print("  %-13s root value variance %.3f, %.2f s, mean regret %.4f" %
+              (name + ":", r[prefix + '_variance'], r[prefix + '_seconds'], r[prefix + '_regret']))
+
+
+def run_schedules(args):
+    r = benchmark_schedules(args.street, args.positions, args.passes, args.interval, args.seed)
+    print("schedules: %d positions from street %d x %d passes, discount every %d iterations, %d infosets" %
+          (r['positions'], args.street, r['passes'], r['interval'], r['nodes']))
+    for name, seconds, regret in zip(("vanilla", "linear", "dcfr", "cfr+"), r['seconds'], r['regret']):
+        print("  %-9s %.2f s, mean regret %.4f" % (name + ":", seconds, regret))
+
+
+def run_check(args):
+    for name, cases in run_checks(args.seed).items():
+        print("  %-16s ok (%d cases)" % (name + ":", cases))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    sub = parser.add_subparsers(dest='bench', required=True)
+
+    p = sub.add_parser('rollouts', help='скорость доигрываний RolloutEvaluator')
+    p.add_argument('--street', type=int, default=1)
+    p.add_argument('--positions', type=int, default=20)
+    p.add_argument('--rollouts', type=int, default=1000)
+    p.add_argument('--seed', type=int, default=0)
+    p.set_defaults(func=run_rollouts)
+
+    p = sub.add_parser('arena', help='пополнения арен обхода и журналов обновлений по итерациям')
+    p.add_argument('--street', type=int, default=4)
+    p.add_argument('--iterations', type=int, default=10)
+    p.add_argument('--seed', type=int, default=0)
+    p.set_defaults(func=run_arena)
+
+    p = sub.add_parser('numa', help='таблица узлов по сокетам против чередования страниц')
+    p.add_argument('--street', type=int, default=4)
+    p.add_argument('--positions', type=int, default=20)
+    p.add_argument('--passes', type=int, default=2)
+    p.add_argument('--threads', type=int, default=0)
+    p.add_argument('--seed', type=int, default=0)
+    p.set_defaults(func=run_numa)
+
+    p = sub.add_parser('interleave', help='чередование обходов с prefetch против рекурсивного обхода')
+    p.add_argument('--street', type=int, default=4)
+    p.add_argument('--positions', type=int, default=50)
+    p.add_argument('--width', type=int, default=8)
+    p.add_argument('--seed', type=int, default=0)
+    p.set_defaults(func=run_interleave)
+
+    p = sub.add_parser('prefetch', help='упреждающая загрузка ячеек таблицы для потомков')
+    p.add_argument('--street', type=int, default=4)
+    p.add_argument('--positions', type=int, default=50)
+    p.add_argument('--distance', type=int, default=1)
+    p.add_argument('--seed', type=int, default=0)
+    p.set_defaults(func=run_prefetch)
+
+    p = sub.add_parser('lazy', help='создание узлов таблицы только на повторных посещениях')
+    p.add_argument('--street', type=int, default=4)
+    p.add_argument('--positions', type=int, default=50)
+    p.add_argument('--passes', type=int, default=1)
+    p.add_argument('--visits', type=int, default=2)
+    p.add_argument('--seed', type=int, default=0)
+    p.set_defaults(func=run_lazy_nodes)
+
+    p = sub.add_parser('hogwild', help='сходимость по времени: журнал под блокировками против hogwild')
+    p.add_argument('--street', type=int, default=4)
+    p.add_argument('--positions', type=int, default=50)
+    p.add_argument('--passes', type=int, default=5)
+    p.add_argument('--threads', type=int, default=0)
+    p.add_argument('--seed', type=int, default=0)
+    p.set_defaults(func=run_hogwild)
+
+    p = sub.add_parser('baselines', help='дисперсия и сходимость Pure CFR с базовыми значениями VR-MCCFR и без них')
+    p.add_argument('--street', type=int, default=4)
+    p.add_argument('--positions', type=int, default=50)
+    p.add_argument('--passes', type=int, default=20)
+    p.add_argument('--seed', type=int, default=0)
+    p.set_defaults(func=run_baselines)
+
+    p = sub.add_parser('schedules', help='сходимость и цена дисконтирования по расписаниям накопления')
+    p.add_argument('--street', type=int, default=4)
+    p.add_argument('--positions', type=int, default=50)
+    p.add_argument('--passes', type=int, default=5)
+    p.add_argument('--interval', type=int, default=1)
+    p.add_argument('--seed', type=int, default=0)
+    p.set_defaults(func=run_schedules)
+
+    p = sub.add_parser('check', help='проверки поведения решателя на случайных данных')
+    p.add_argument('--seed', type=int, default=0)
+    p.set_defaults(func=run_check)
+
+    args = parser.parse_args()
+    args.func(args)
+
+
+if __name__ == '__main__':
+    main()
@@ -1,9 +1,190 @@
 # cython: language_level=3
 from libcpp.string cimport string
+from libcpp.vector cimport vector
 
 cdef extern from "mccfr_solver.hpp" namespace "ofc":
+    cdef struct SolverConfig:
+        int max_street
+        int leaf_estimator
+        int leaf_batch_size
+        int rollout_min
+        int rollout_max
+        double rollout_std_error
+        int update_flush_threshold
+        int task_depth
+        int task_min_actions
+        int parallel_backend
+        int num_threads
+        int pin_threads
+        int numa_mode
+        int interleave_traversals
+        int prefetch_distance
+        int storage
+        double regret_scale
+        double regret_floor
+        int sparse_top_k
+        int huge_pages
+        int hot_depth
+        int hot_reduce_interval
+        int materialize_visits
+        int regret_pruning
+        double prune_threshold
+        int prune_warmup
+        double prune_explore
+        int schedule
+        int discount_interval
+        double dcfr_alpha
+        double dcfr_beta
+        double dcfr_gamma
+        int averaging_delay
+        int regret_matching
+        int pure_cfr
+        int hogwild
+        int vr_baselines
+        double baseline_alpha
+        int alternating_updates
+        int lazy_strategy_sums
+
     cdef cppclass MCCFRSolver:
         MCCFRSolver()
-        void train(int iterations)
-        void save_strategy(const string& path)
-        void load_strategy(const string& path)
+        MCCFRSolver(const string& fantasyland_table_path) except +
+        void train(int iterations) except +
+        void save_strategy(const string& path) except +
+        void load_strategy(const string& path) except +
+        void set_fantasyland_bonus(int card_count, float value) except +
+        void load_fantasyland_table(const string& path) except +
+        const SolverConfig& get_config()
+        void set_config(const SolverConfig& config) except +
+        void load_leaf_table(const string& path) except +
+        size_t get_node_count()
+        size_t get_node_counter_count()
+        long long get_arena_refills()
+        long long get_child_prefetches()
+        long long get_iteration_count()
+        long long get_traversed_edges()
+        long long get_pruned_edges()
+        double get_mean_regret()
+        int get_num_threads()
+        int get_numa_bind_failures()
+        size_t get_table_used_bytes()
+        size_t get_table_mapped_bytes()
+
+    void build_fantasyland_table_cpp "ofc::build_fantasyland_table"(
+        const string& path, int samples_per_tier, const vector[int]& dead_counts, unsigned long long seed) except +
+
+    cdef struct RolloutBenchmarkResult:
+        int positions
+        long long rollouts
+        double seconds
+        double rollouts_per_second
+        double parallel_seconds
+        double parallel_rollouts_per_second
+
+    RolloutBenchmarkResult benchmark_rollouts_cpp "ofc::benchmark_rollouts"(
+        int street, int positions, int rollouts_per_position, unsigned long long seed) except +
+
+    cdef struct ArenaBenchmarkResult:
+        int iterations
+        long long warmup_refills
+        long long steady_refills
+        long long nodes
+        double seconds
+
+    ArenaBenchmarkResult benchmark_arena_cpp "ofc::benchmark_arena"(
+        int street, int iterations, unsigned long long seed) except +
+
+    cdef struct NumaBenchmarkResult:
+        int numa_nodes
+        int threads
+        int positions
+        long long nodes
+        double local_seconds
+        double interleaved_seconds
+        int bind_failures
+
+    NumaBenchmarkResult benchmark_numa_cpp "ofc::benchmark_numa"(
+        int street, int positions, int passes, int threads, unsigned long long seed) except +
+
+    cdef struct InterleaveBenchmarkResult:
+        int positions
+        int width
+        long long nodes
+        double serial_seconds
+        double interleaved_seconds
+
+    InterleaveBenchmarkResult benchmark_interleave_cpp "ofc::benchmark_interleave"(
+        int street, int positions, int width, unsigned long long seed) except +
+
+    cdef struct PrefetchBenchmarkResult:
+        int positions
+        int distance
+        long long nodes
+        long long prefetches
+        double baseline_seconds
+        double prefetch_seconds
+        long long baseline_cache_misses
+        long long prefetch_cache_misses
+
+    PrefetchBenchmarkResult benchmark_prefetch_cpp "ofc::benchmark_prefetch"(
+        int street, int positions, int distance, unsigned long long seed) except +
+
+    cdef struct LazyNodesBenchmarkResult:
+        int positions
+        int passes
+        int visits
+        long long eager_nodes
+        long long lazy_nodes
+        long long lazy_counters
+        long long eager_bytes
+        long long lazy_bytes
+        double eager_seconds
+        double lazy_seconds
+        long long pure_nodes
+        long long pure_eager_bytes
+        long long pure_lazy_bytes
+
+    LazyNodesBenchmarkResult benchmark_lazy_nodes_cpp "ofc::benchmark_lazy_nodes"(
+        int street, int positions, int passes, int visits, unsigned long long seed) except +
+
+    cdef struct HogwildBenchmarkResult:
+        int positions
+        int threads
+        long long nodes
+        vector[double] locked_seconds
+        vector[double] locked_regret
+        vector[double] hogwild_seconds
+        vector[double] hogwild_regret
+
+    HogwildBenchmarkResult benchmark_hogwild_cpp "ofc::benchmark_hogwild"(
+        int street, int positions, int passes, int threads, unsigned long long seed) except +
+
+    cdef struct BaselineBenchmarkResult:
+        int positions
+        int passes
+        long long nodes
+        double plain_variance
+        double baseline_variance
+        double plain_seconds
+        double baseline_seconds
+        double plain_regret
+        double baseline_regret
+
+    BaselineBenchmarkResult benchmark_baselines_cpp "ofc::benchmark_baselines"(
+        int street, int positions, int passes, unsigned long long seed) except +
+
+    cdef struct ScheduleBenchmarkResult:
+        int positions
+        int passes
+        int interval
+        long long nodes
+        vector[double] seconds
+        vector[double] regret
+
+    ScheduleBenchmarkResult benchmark_schedules_cpp "ofc::benchmark_schedules"(
+        int street, int positions, int passes, int interval, unsigned long long seed) except +
+
+cdef extern from "self_checks.hpp" namespace "ofc":
+    int check_foul_bounds_cpp "ofc::check_foul_bounds"(int boards, unsigned long long seed) except +
+    int check_fantasyland_solver_cpp "ofc::check_fantasyland_solver"(int hands, unsigned long long seed) except +
+    int check_pruning_isolation_cpp "ofc::check_pruning_isolation"(int positions, unsigned long long seed) except +
+    int check_strategy_files_cpp "ofc::check_strategy_files"(int positions, unsigned long long seed) except +
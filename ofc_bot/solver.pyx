@@ -1,26 +1,272 @@
 # cython: language_level=3, language=c++
 # distutils: language = c++
 from libcpp.string cimport string
+from libcpp.vector cimport vector
+import os
+import struct
+import tempfile
 
 cdef extern from "mccfr_solver.hpp" namespace "ofc":
+    cdef struct SolverConfig:
+        int max_street
+        int leaf_estimator
+        int leaf_batch_size
+        int rollout_min
+        int rollout_max
+        double rollout_std_error
+        int update_flush_threshold
+        int task_depth
+        int task_min_actions
+        int parallel_backend
+        int num_threads
+        int pin_threads
+        int numa_mode
+        int interleave_traversals
+        int prefetch_distance
+        int storage
+        double regret_scale
+        double regret_floor
+        int sparse_top_k
+        int huge_pages
+        int hot_depth
+        int hot_reduce_interval
+        int materialize_visits
+        int regret_pruning
+        double prune_threshold
+        int prune_warmup
+        double prune_explore
+        int schedule
+        int discount_interval
+        double dcfr_alpha
+        double dcfr_beta
+        double dcfr_gamma
+        int averaging_delay
+        int regret_matching
+        int pure_cfr
+        int hogwild
+        int vr_baselines
+        double baseline_alpha
+        int alternating_updates
+        int lazy_strategy_sums
+
     cdef cppclass MCCFRSolver:
         MCCFRSolver()
-        void train(int iterations)
-        void save_strategy(const string& path)
-        void load_strategy(const string& path)
+        MCCFRSolver(const string& fantasyland_table_path) except +
+        void train(int iterations) except +
+        void save_strategy(const string& path) except +
+        void load_strategy(const string& path) except +
+        void set_fantasyland_bonus(int card_count, float value) except +
+        void load_fantasyland_table(const string& path) except +
+        const SolverConfig& get_config()
+        void set_config(const SolverConfig& config) except +
+        void load_leaf_table(const string& path) except +
+        size_t get_node_count()
+        size_t get_node_counter_count()
+        long long get_arena_refills()
+        long long get_child_prefetches()
+        long long get_iteration_count()
+        long long get_traversed_edges()
+        long long get_pruned_edges()
+        double get_mean_regret()
+        int get_num_threads()
+        int get_numa_bind_failures()
+        size_t get_table_used_bytes()
+        size_t get_table_mapped_bytes()
+
+    void build_fantasyland_table_cpp "ofc::build_fantasyland_table"(
+        const string& path, int samples_per_tier, const vector[int]& dead_counts, unsigned long long seed) except +
+
+    cdef struct RolloutBenchmarkResult:
+        int positions
+        long long rollouts
+        double seconds
+        double rollouts_per_second
+        double parallel_seconds
+        double parallel_rollouts_per_second
+
+    RolloutBenchmarkResult benchmark_rollouts_cpp "ofc::benchmark_rollouts"(
+        int street, int positions, int rollouts_per_position, unsigned long long seed) except +
+
+    cdef struct ArenaBenchmarkResult:
+        int iterations
+        long long warmup_refills
+        long long steady_refills
+        long long nodes
+        double seconds
+
+    ArenaBenchmarkResult benchmark_arena_cpp "ofc::benchmark_arena"(
+        int street, int iterations, unsigned long long seed) except +
+
+    cdef struct NumaBenchmarkResult:
+        int numa_nodes
+        int threads
+        int positions
+        long long nodes
+        double local_seconds
+        double interleaved_seconds
+        int bind_failures
+
+    NumaBenchmarkResult benchmark_numa_cpp "ofc::benchmark_numa"(
+        int street, int positions, int passes, int threads, unsigned long long seed) except +
+
+    cdef struct InterleaveBenchmarkResult:
+        int positions
+        int width
+        long long nodes
+        double serial_seconds
+        double interleaved_seconds
+
+    InterleaveBenchmarkResult benchmark_interleave_cpp "ofc::benchmark_interleave"(
+        int street, int positions, int width, unsigned long long seed) except +
+
+    cdef struct PrefetchBenchmarkResult:
+        int positions
+        int distance
+        long long nodes
+        long long prefetches
+        double baseline_seconds
+        double prefetch_seconds
+        long long baseline_cache_misses
+        long long prefetch_cache_misses
+
+    PrefetchBenchmarkResult benchmark_prefetch_cpp "ofc::benchmark_prefetch"(
+        int street, int positions, int distance, unsigned long long seed) except +
+
+    cdef struct LazyNodesBenchmarkResult:
+        int positions
+        int passes
+        int visits
+        long long eager_nodes
+        long long lazy_nodes
+        long long lazy_counters
+        long long eager_bytes
+        long long lazy_bytes
+        double eager_seconds
+        double lazy_seconds
+        long long pure_nodes
+        long long pure_eager_bytes
+        long long pure_lazy_bytes
+
+    LazyNodesBenchmarkResult benchmark_lazy_nodes_cpp "ofc::benchmark_lazy_nodes"(
+        int street, int positions, int passes, int visits, unsigned long long seed) except +
+
+    cdef struct HogwildBenchmarkResult:
+        int positions
+        int threads
+        long long nodes
+        vector[double] locked_seconds
+        vector[double] locked_regret
+        vector[double] hogwild_seconds
+        vector[double] hogwild_regret
+
+    HogwildBenchmarkResult benchmark_hogwild_cpp "ofc::benchmark_hogwild"(
+        int street, int positions, int passes, int threads, unsigned long long seed) except +
+
+    cdef struct BaselineBenchmarkResult:
+        int positions
+        int passes
+        long long nodes
+        double plain_variance
+        double baseline_variance
+        double plain_seconds
+        double baseline_seconds
+        double plain_regret
+        double baseline_regret
+
+    BaselineBenchmarkResult benchmark_baselines_cpp "ofc::benchmark_baselines"(
+        int street, int positions, int passes, unsigned long long seed) except +
+
+    cdef struct ScheduleBenchmarkResult:
+        int positions
+        int passes
+        int interval
+        long long nodes
+        vector[double] seconds
+        vector[double] regret
+
+    ScheduleBenchmarkResult benchmark_schedules_cpp "ofc::benchmark_schedules"(
+        int street, int positions, int passes, int interval, unsigned long long seed) except +
+
+cdef extern from "self_checks.hpp" namespace "ofc":
+    int check_foul_bounds_cpp "ofc::check_foul_bounds"(int boards, unsigned long long seed) except +
+    int check_fantasyland_solver_cpp "ofc::check_fantasyland_solver"(int hands, unsigned long long seed) except +
+    int check_pruning_isolation_cpp "ofc::check_pruning_isolation"(int positions, unsigned long long seed) except +
+    int check_strategy_files_cpp "ofc::check_strategy_files"(int positions, unsigned long long seed) except +
 
 cdef class Solver:
     cdef MCCFRSolver* solver_ptr
 
-    def __cinit__(self):
-        self.solver_ptr = new MCCFRSolver()
+    def __cinit__(self, fantasyland_table=None):
+        cdef string table_path
+        if fantasyland_table is None:
+            self.solver_ptr = new MCCFRSolver()
+        else:
+            table_path = fantasyland_table.encode('UTF-8')
+            self.solver_ptr = new MCCFRSolver(table_path)
 
     def __dealloc__(self):
         del self.solver_ptr
 
+    def configure(self, **options):
+        """Обновляет поля SolverConfig по имени, например configure(max_street=2)."""
+        cdef SolverConfig config = self.solver_ptr.get_config()
+        cdef dict values = config
+        unknown = set(options) - set(values)
+        if unknown:
+            raise ValueError("Unknown solver options: %s" % ", ".join(sorted(unknown)))
+        values.update(options)
+        config = values
+        self.solver_ptr.set_config(config)
+
+    def get_config(self):
+        return self.solver_ptr.get_config()
+
+    def load_leaf_table(self, path):
+        cdef string path_str = path.encode('UTF-8')
+        self.solver_ptr.load_leaf_table(path_str)
+
     def train(self, int iterations):
         self.solver_ptr.train(iterations)
 
+    @property
+    def num_threads(self):
+        """Число потоков обучения (пул решателя или OpenMP, см. configure(parallel_backend=...))."""
+        return self.solver_ptr.get_num_threads()
+
+    def node_count(self):
+        return self.solver_ptr.get_node_count()
+
+    def node_counter_count(self):
+        """Узлы, у которых пока только счетчик посещений (configure(materialize_visits=...))."""
+        return self.solver_ptr.get_node_counter_count()
+
+    def arena_refills(self):
+        """Новые блоки арен обхода и расширения журналов обновлений; прочие выделения памяти не учитываются."""
+        return self.solver_ptr.get_arena_refills()
+
+    def child_prefetches(self):
+        """Сколько ячеек таблицы запрошено заранее для потомков (configure(prefetch_distance=...))."""
+        return self.solver_ptr.get_child_prefetches()
+
+    def iteration_count(self):
+        return self.solver_ptr.get_iteration_count()
+
+    def edge_counts(self):
+        """Ребра к потомкам: (обойдено, отсечено по сожалениям) — см. configure(regret_pruning=1)."""
+        return self.solver_ptr.get_traversed_edges(), self.solver_ptr.get_pruned_edges()
+
+    def mean_regret(self):
+        """Средний по узлам наибольший положительный регрет на итерацию — мера сходимости."""
+        return self.solver_ptr.get_mean_regret()
+
+    def table_bytes(self):
+        """Память таблицы узлов: (занято записями и индексом, взято у системы) в байтах."""
+        return self.solver_ptr.get_table_used_bytes(), self.solver_ptr.get_table_mapped_bytes()
+
+    def numa_bind_failures(self):
+        """Сколько кусков таблицы узлов не удалось привязать к узлам NUMA (configure(numa_mode=...))."""
+        return self.solver_ptr.get_numa_bind_failures()
+
     def save(self, path):
         cdef string path_str = path.encode('UTF-8')
         self.solver_ptr.save_strategy(path_str)
@@ -28,3 +274,76 @@ cdef class Solver:
     def load(self, path):
         cdef string path_str = path.encode('UTF-8')
         self.solver_ptr.load_strategy(path_str)
+
+    def set_fantasyland_bonus(self, int card_count, float value):
+        self.solver_ptr.set_fantasyland_bonus(card_count, value)
+
+    def load_fantasyland_table(self, path):
+        cdef string path_str = path.encode('UTF-8')
+        self.solver_ptr.load_fantasyland_table(path_str)
+
+
+def build_fantasyland_table(path, int samples_per_tier=2000, dead_counts=(0,), unsigned long long seed=0):
+    cdef string path_str = path.encode('UTF-8')
+    cdef vector[int] counts = list(dead_counts)
+    build_fantasyland_table_cpp(path_str, samples_per_tier, counts, seed)
+
+
+def benchmark_rollouts(int street=1, int positions=20, int rollouts_per_position=1000, unsigned long long seed=0):
+    return benchmark_rollouts_cpp(street, positions, rollouts_per_position, seed)
+
+
+def benchmark_arena(int street=4, int iterations=10, unsigned long long seed=0):
+    return benchmark_arena_cpp(street, iterations, seed)
+
+
+def benchmark_numa(int street=4, int positions=20, int passes=2, int threads=0, unsigned long long seed=0):
+    return benchmark_numa_cpp(street, positions, passes, threads, seed)
+
+
+def benchmark_interleave(int street=4, int positions=50, int width=8, unsigned long long seed=0):
+    return benchmark_interleave_cpp(street, positions, width, seed)
+
+
+def benchmark_prefetch(int street=4, int positions=50, int distance=1, unsigned long long seed=0):
+    return benchmark_prefetch_cpp(street, positions, distance, seed)
+
+
+def benchmark_lazy_nodes(int street=4, int positions=50, int passes=1, int visits=2, unsigned long long seed=0):
+    return benchmark_lazy_nodes_cpp(street, positions, passes, visits, seed)
+
+
+def benchmark_hogwild(int street=4, int positions=50, int passes=5, int threads=0, unsigned long long seed=0):
+    return benchmark_hogwild_cpp(street, positions, passes, threads, seed)
+
+
+def benchmark_baselines(int street=4, int positions=50, int passes=20, unsigned long long seed=0):
+    return benchmark_baselines_cpp(street, positions, passes, seed)
+
+
+def benchmark_schedules(int street=4, int positions=50, int passes=5, int interval=1, unsigned long long seed=0):
+    return benchmark_schedules_cpp(street, positions, passes, interval, seed)
+
+
+def _check_bad_strategy_header(unsigned long long seed):
+    """Файл с сигнатурой OFCSTRAT и неизвестной версией: Solver.load бросает RuntimeError."""
+    path = os.path.join(tempfile.gettempdir(), 'ofc_check_bad_header_%d.bin' % seed)
+    with open(path, 'wb') as f:
+        f.write(b'OFCSTRAT' + struct.pack('=II', 99, 0))
+    try:
+        Solver().load(path)
+    except RuntimeError:
+        return 1
+    finally:
+        os.remove(path)
+    raise RuntimeError("check_strategy_files: strategy file version 99 was accepted")
+
+
+def run_checks(unsigned long long seed=0):
+    """Проверки поведения решателя; при расхождении бросает RuntimeError. Возвращает число проверенных случаев."""
+    return {
+        'foul_bounds': check_foul_bounds_cpp(400, seed),
+        'fantasyland': check_fantasyland_solver_cpp(12, seed),
+        'pruning': check_pruning_isolation_cpp(3, seed),
+        'strategy_files': check_strategy_files_cpp(10, seed) + _check_bad_strategy_header(seed),
+    }